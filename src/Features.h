@@ -58,6 +58,54 @@
   #define ENABLE_CONFIG 1
 #endif
 
+#if ENABLE_HOOKS && ENABLE_CONFIG
+  // Send notification hooks to gateway in batches (/api/notifications)
+  #ifndef ENABLE_NOTIFICATIONS_BATCHING
+    #define ENABLE_NOTIFICATIONS_BATCHING 0
+  #endif
+#else
+  #define ENABLE_NOTIFICATIONS_BATCHING 0
+#endif
+
+// Keep sensors, actions and config entries in fixed size arrays instead of heap.
+// Their names (and action captions) are not copied, so they must be string literals.
+#ifndef ENABLE_STATIC_REGISTRY
+  #define ENABLE_STATIC_REGISTRY 0
+#endif
+
+#if ENABLE_STATIC_REGISTRY
+  // Max sensors of each type (number, text)
+  #ifndef STATIC_REGISTRY_MAX_SENSORS
+    #define STATIC_REGISTRY_MAX_SENSORS 8
+  #endif
+  #ifndef STATIC_REGISTRY_MAX_ACTIONS
+    #define STATIC_REGISTRY_MAX_ACTIONS 8
+  #endif
+  #ifndef STATIC_REGISTRY_MAX_CONFIG
+    #define STATIC_REGISTRY_MAX_CONFIG 8
+  #endif
+#else
+  // Registries grow on demand
+  #define STATIC_REGISTRY_MAX_SENSORS 0
+  #define STATIC_REGISTRY_MAX_ACTIONS 0
+  #define STATIC_REGISTRY_MAX_CONFIG 0
+#endif
+
+// Server-Sent Events stream (/events) of sensor changes, hook calls and log lines
+#ifndef ENABLE_EVENTS
+  #define ENABLE_EVENTS 1
+#endif
+
+// esp8266 WiFiClient connects only blocking, that would stall loop() on every reconnect
+#if ENABLE_CONFIG && ENABLE_EVENTS && defined(ARDUINO_ARCH_ESP32)
+  // Keep websocket connection to gateway: commands in, events out
+  #ifndef ENABLE_GATEWAY_WS
+    #define ENABLE_GATEWAY_WS 0
+  #endif
+#else
+  #define ENABLE_GATEWAY_WS 0
+#endif
+
 // Enable ArduinoOTA
 #ifndef ENABLE_OTA
   #define ENABLE_OTA 1
@@ -1,5 +1,6 @@
 #include "SmartThing.h"
 #include "settings/SettingsRepository.h"
+#include "net/gateway/GatewayClient.h"
 
 #include <ArduinoOTA.h>
 
@@ -7,10 +8,6 @@
   #define SMART_THING_LOOP_TASK_DELAY 50  // ms
 #endif
 
-#ifndef SMART_THING_HOOKS_CHECK_DELAY
-  #define SMART_THING_HOOKS_CHECK_DELAY 500 // ms
-#endif
-
 #ifndef SMART_THING_BEACON_SEND_DELAY
   #define SMART_THING_BEACON_SEND_DELAY 2000 //ms
 #endif
@@ -68,15 +65,15 @@ void SmartThingClass::preInit() {
   #if ENABLE_LOGGER && LOGGER_TYPE != SERIAL_LOGGER
     ConfigManager.add(LOGGER_ADDRESS_CONFIG);
     #if ENABLE_TEXT_SENSORS
-      SensorsManager.add("logger", []() {
-        return LOGGER.isConnected() ? "connected" : "disconnected";
+      SensorsManager.add("logger", [](char * buffer, size_t size) {
+        return (size_t) snprintf(buffer, size, "%s", LOGGER.isConnected() ? "connected" : "disconnected");
       });
     #endif
   #endif
 
   #if ENABLE_CONFIG
-    #if ENABLE_HOOKS
-      // For notifications
+    #if ENABLE_HOOKS || ENABLE_GATEWAY_WS
+      // For notifications and gateway connection
       ConfigManager.add(GATEWAY_CONFIG);
     #endif
 
@@ -85,6 +82,7 @@ void SmartThingClass::preInit() {
   #endif
 
   #if ENABLE_HOOKS
+    HooksDispatcher.begin();
     st_log_debug(_SMART_THING_TAG, "Loading hooks from settings...");
     HooksManager.loadFromSettings();
     st_log_debug(_SMART_THING_TAG, "Hooks loaded, making first check");
@@ -154,6 +152,10 @@ bool SmartThingClass::init(const char * type) {
   st_log_debug(_SMART_THING_TAG, "Loop task created");
   #endif
 
+  #if ENABLE_GATEWAY_WS
+    GatewayClient.begin();
+  #endif
+
   setupWiFi();
 
   st_log_info(_SMART_THING_TAG, "Setup finished");
@@ -172,11 +174,24 @@ void SmartThingClass::loop() {
     _lastBeacon = current;
   }
 
+  SettingsRepository.tick();
+
   #if ENABLE_HOOKS
-    if (_lastHooksCheck == 0 || current - _lastHooksCheck > SMART_THING_HOOKS_CHECK_DELAY) {
-      HooksManager.check();
-      _lastHooksCheck = current;
-    }
+    // each sensor has own interval, manager checks only due ones
+    HooksManager.check();
+    #if !HOOKS_DISPATCH_ASYNC
+      // deliver http/notification hooks fired above
+      HooksDispatcher.process();
+    #endif
+    HttpConnectionPool.evictIdle();
+    #if ENABLE_NOTIFICATIONS_BATCHING
+      NotificationsBatcher.tick();
+    #endif
+  #endif
+
+  #if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+    // REST reads sensors values from here instead of calling providers
+    SensorsManager.publishSnapshot();
   #endif
   
   #if ENABLE_ACTIONS_SCHEDULER
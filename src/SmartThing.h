@@ -60,10 +60,6 @@ class SmartThingClass {
   bool _initialized = false;
   unsigned long _lastBeacon = 0;
 
-  #if ENABLE_HOOKS
-    unsigned long _lastHooksCheck = 0;
-  #endif
-
   #if ENABLE_ACTIONS_SCHEDULER
     unsigned long _lastActionsCheck = 0;
   #endif
@@ -24,42 +24,40 @@ size_t ActionsManagerClass::count() {
 }
 
 bool ActionsManagerClass::add(const char* name, const char* caption, ActionHandler handler) {
-  if (findAction(name) != _actions.end()) {
+  if (_actions.contains(name)) {
     st_log_warning(_ACTIONS_TAG,
                     "Action with name %s already exists!:",
                     name);
     return false;
   }
 
-  Action * action = new Action(name, caption, handler);
-  _actions.push_back(action);
+  Action * action = _actions.add(name, caption, handler);
+  if (action == nullptr) {
+    st_log_error(_ACTIONS_TAG, "Failed to add action %s, registry is full", name);
+    return false;
+  }
   st_log_debug(_ACTIONS_TAG, "Added new action handler - %s:%s", action->name(), action->caption());
   return true;
 };
 
 bool ActionsManagerClass::remove(const char* name) {
-  auto action = findAction(name);
-  if (action == _actions.end()) {
+  if (!_actions.remove(name)) {
     st_log_warning(_ACTIONS_TAG, "There is no action with name %s", name);
     return false;
   }
 
-  delete *action;
-  *action = nullptr;
-  _actions.erase(action);
-
   st_log_warning(_ACTIONS_TAG, "Action %s removed", name);
   return true;
 }
 
 ActionResultCode ActionsManagerClass::call(const char* name) {
-  auto action = findAction(name);
-  if (action == _actions.end()) {
+  Action * action = _actions.find(name);
+  if (action == nullptr) {
     st_log_error(_ACTIONS_TAG, "Can't find action with name %s", name);
     return ACTION_RESULT_NOT_FOUND;
   }
   st_log_info(_ACTIONS_TAG, "Calling action name=%s", name);
-  return (*action)->call() ? ACTION_RESULT_SUCCESS : ACTION_RESULT_ERROR;
+  return action->call() ? ACTION_RESULT_SUCCESS : ACTION_RESULT_ERROR;
 };
 
 #if ENABLE_ACTIONS_SCHEDULER
@@ -81,12 +79,11 @@ void ActionsManagerClass::loadFromSettings() {
 
 bool ActionsManagerClass::updateActionSchedule(const char * name, unsigned long newDelay) {
   st_log_debug(_ACTIONS_TAG, "Trying to update action %s delay", name);
-  auto it = findAction(name);
-  if (it == _actions.end()) {
+  Action * action = _actions.find(name);
+  if (action == nullptr) {
     st_log_error(_ACTIONS_TAG, "Can't find action with name %s", name);
     return false;
   } else {
-    Action *action = *it;
     JsonDocument config = SettingsRepository.getActions();
     if (newDelay == 0) {
       config.remove(action->name());
@@ -179,10 +176,4 @@ String ActionsManagerClass::toJson() {
   return result;
 };
 
-std::list<Action*>::iterator ActionsManagerClass::findAction(const char* name) {
-  return std::find_if(_actions.begin(), _actions.end(), [name](const Action * action) {
-    return strcmp(action->name(), name) == 0;
-  });
-}
-
 #endif
\ No newline at end of file
@@ -5,8 +5,9 @@
 #if ENABLE_ACTIONS
 
 #include <Arduino.h>
-#include <functional>
-#include <list>
+
+#include "utils/InlineFunction.h"
+#include "utils/Registry.h"
 
 enum ActionResultCode {
   ACTION_RESULT_NOT_FOUND = -1,
@@ -14,7 +15,7 @@ enum ActionResultCode {
   ACTION_RESULT_SUCCESS = 1,
 };
 
-typedef std::function<bool(void)> ActionHandler;
+typedef InlineFunction<bool(void)> ActionHandler;
 
 class Action {
   public:
@@ -25,22 +26,15 @@ class Action {
       : _handler(h)
     #endif
     {
-      _name = (char *) malloc(strlen(name) + 1);
-      strcpy(_name, name);
-
-      if (strcmp(name, caption) == 0) {
-        _caption = _name;
-      } else {
-        _caption = (char *) malloc(strlen(caption) + 1);
-        strcpy(_caption, caption);
-      }
+      _name = registryName(name);
+      _caption = strcmp(name, caption) == 0 ? _name : registryName(caption);
     };
 
     ~Action() {
       if (_name != _caption) {
-        free(_caption);
+        freeRegistryName(_caption);
       }
-      free(_name);
+      freeRegistryName(_name);
     };
 
     const char * name() const {
@@ -74,8 +68,8 @@ class Action {
     #endif
 
   private:
-    char* _name;
-    char* _caption;
+    const char * _name;
+    const char * _caption;
     ActionHandler _handler;
 
     #if ENABLE_ACTIONS_SCHEDULER
@@ -120,9 +114,7 @@ class ActionsManagerClass {
   String toJson();
   size_t count();
  private:
-  std::list<Action*> _actions;
-
-  std::list<Action*>::iterator findAction(const char* name);
+  Registry<Action, STATIC_REGISTRY_MAX_ACTIONS> _actions;
 };
 
 extern ActionsManagerClass ActionsManager;
@@ -10,13 +10,6 @@ ConfigManagerClass ConfigManager;
 ConfigManagerClass::ConfigManagerClass() {}
 ConfigManagerClass::~ConfigManagerClass() {}
 
-
-std::list<ConfigEntry*>::iterator ConfigManagerClass::findConfigEntry(const char * name) {
-  return std::find_if(_config.begin(), _config.end(), [name](const ConfigEntry * entry) {
-    return strcmp(entry->name(), name) == 0;
-  });
-}
-
 bool ConfigManagerClass::add(const char* name) {
   if (name == nullptr) {
     return false;
@@ -27,23 +20,40 @@ bool ConfigManagerClass::add(const char* name) {
     return false;
   }
 
-  String fixedName = name;
-  fixedName.replace(" ", "-");
-  fixedName.replace(";", "-");
+  #if ENABLE_STATIC_REGISTRY
+    // literal is kept as is, so it can't be fixed
+    if (strchr(name, ' ') != nullptr || strchr(name, ';') != nullptr) {
+      st_log_warning(_CONFIG_MANAGER_TAG, "Config entry name %s can't contain spaces and ';'", name);
+      return false;
+    }
+    const char * fixedName = name;
+  #else
+    String fixedNameStr = name;
+    fixedNameStr.replace(" ", "-");
+    fixedNameStr.replace(";", "-");
+    const char * fixedName = fixedNameStr.c_str();
+  #endif
 
-  auto it = findConfigEntry(fixedName.c_str());
-  if (it != _config.end()) {
-    st_log_warning(_CONFIG_MANAGER_TAG, "Config entry %s already exists!", fixedName);
-    return false;
-  }
+  {
+    LockGuard guard(_lock);
+    if (_config.contains(fixedName)) {
+      st_log_warning(_CONFIG_MANAGER_TAG, "Config entry %s already exists!", fixedName);
+      return false;
+    }
 
-  _config.push_back(new ConfigEntry(fixedName.c_str()));
+    if (_config.add(fixedName) == nullptr) {
+      st_log_error(_CONFIG_MANAGER_TAG, "Failed to add config entry %s, registry is full", fixedName);
+      return false;
+    }
+    _version++;
+  }
   st_log_debug(_CONFIG_MANAGER_TAG, "Added new config entry - %s", fixedName);
   return true;
 }
 
 String ConfigManagerClass::getConfigJson() {
   String result = "{";
+  LockGuard guard(_lock);
 
   for (auto it = _config.begin(); it != _config.end(); ++it) {
     ConfigEntry * current = *it;
@@ -68,13 +78,23 @@ const char * ConfigManagerClass::get(const char * name) {
     return "";
   }
 
-  auto it = findConfigEntry(name);
-  if (it == _config.end()) {
+  ConfigEntry * entry = _config.find(name);
+  if (entry == nullptr) {
     st_log_warning(_CONFIG_MANAGER_TAG, _errorConfigEntryNotFound, name);
     return "";
   }
 
-  return (*it)->value();
+  return entry->value();
+}
+
+ConfigEntry * ConfigManagerClass::getEntry(const char * name) {
+  LockGuard guard(_lock);
+  return _config.find(name);
+}
+
+void ConfigManagerClass::copyValue(const ConfigEntry * entry, String &target) {
+  LockGuard guard(_lock);
+  target = entry->value();
 }
 
 
@@ -99,15 +119,17 @@ bool ConfigManagerClass::setConfigValueWithoutSave(const char * name, const char
     return false;
   }
 
-  auto it = findConfigEntry(name);
-  if (it == _config.end()) {
-    st_log_warning(_CONFIG_MANAGER_TAG, _errorConfigEntryNotFound, name);
-    return false;
+  {
+    LockGuard guard(_lock);
+    ConfigEntry * entry = _config.find(name);
+    if (entry != nullptr) {
+      entry->setValue(value);
+      _version++;
+      return true;
+    }
   }
-
-
-  (*it)->setValue(value);
-  return true;
+  st_log_warning(_CONFIG_MANAGER_TAG, _errorConfigEntryNotFound, name);
+  return false;
 }
 
 bool ConfigManagerClass::set(const char * name, const char * value) {
@@ -123,15 +145,19 @@ bool ConfigManagerClass::setConfig(JsonDocument conf) {
     return false;
   }
 
-  for (auto it = _config.begin(); it != _config.end(); ++it) {
-    ConfigEntry * current = *it;
+  {
+    LockGuard guard(_lock);
+    for (auto it = _config.begin(); it != _config.end(); ++it) {
+      ConfigEntry * current = *it;
 
-    if (conf[current->name()].is<String>()) {
-      String value = conf[current->name()].as<String>();
-      current->setValue(value.isEmpty() ? nullptr : value.c_str());
-    } else {
-      current->setValue(nullptr);
+      if (conf[current->name()].is<String>()) {
+        String value = conf[current->name()].as<String>();
+        current->setValue(value.isEmpty() ? nullptr : value.c_str());
+      } else {
+        current->setValue(nullptr);
+      }
     }
+    _version++;
   }
   
   return saveConfig();
@@ -141,8 +167,12 @@ bool ConfigManagerClass::dropConfig() {
   bool res = false;
   
   if (SettingsRepository.setConfig(emptyString)) {
-    for (auto it = _config.begin(); it != _config.end(); ++it) {
-      (*it)->setValue(nullptr);
+    {
+      LockGuard guard(_lock);
+      for (auto it = _config.begin(); it != _config.end(); ++it) {
+        (*it)->setValue(nullptr);
+      }
+      _version++;
     }
 
     st_log_warning(_CONFIG_MANAGER_TAG, "Config droped");
@@ -163,23 +193,26 @@ bool ConfigManagerClass::saveConfig() {
   // todo probably can be optimized
   String data;
 
-  for (auto it = _config.begin(); it != _config.end(); ++it) {
-    ConfigEntry * entry = *it;
-
-    if (entry->value() != nullptr && strlen(entry->value()) > 0) {
-      String value = entry->value();
-      value.replace(";", "|;");
-
-      char buff[strlen(entry->name()) + value.length() + 3];
-      sprintf(
-        buff,
-        "%s;%s%s",
-        entry->name(),
-        value.c_str(),
-        it == std::prev(_config.end()) ? "" : ";"
-      );
-
-      data += String(buff);
+  {
+    LockGuard guard(_lock);
+    for (auto it = _config.begin(); it != _config.end(); ++it) {
+      ConfigEntry * entry = *it;
+
+      if (entry->value() != nullptr && strlen(entry->value()) > 0) {
+        String value = entry->value();
+        value.replace(";", "|;");
+
+        char buff[strlen(entry->name()) + value.length() + 3];
+        sprintf(
+          buff,
+          "%s;%s%s",
+          entry->name(),
+          value.c_str(),
+          it == std::prev(_config.end()) ? "" : ";"
+        );
+
+        data += String(buff);
+      }
     }
   }
 
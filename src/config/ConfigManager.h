@@ -6,10 +6,12 @@
 #if ENABLE_CONFIG
 
 #include <Arduino.h>
-#include <list>
 #include <functional>
 #include <ArduinoJson.h>
 
+#include "utils/Lock.h"
+#include "utils/Registry.h"
+
 #define LOGGER_ADDRESS_CONFIG "laddr"
 #define GATEWAY_CONFIG "gtw"
 #define MAX_CONFIG_ENTRY_NAME_LENGTH 10
@@ -18,11 +20,10 @@ class ConfigEntry {
   public:
     ConfigEntry(const char* name)
         : _value(nullptr) {
-      _name = (char*) malloc(strlen(name) + 1);
-      strcpy(_name, name);
+      _name = registryName(name);
     };
     ~ConfigEntry() {
-      free(_name);
+      freeRegistryName(_name);
       if (_value != nullptr) {
         free(_value);
       }
@@ -48,7 +49,7 @@ class ConfigEntry {
     }
 
   private:
-    char* _name;
+    const char * _name;
     char* _value;
 };
 
@@ -68,9 +69,21 @@ class ConfigManagerClass {
     /*
       Get config value
       @param name system name
-      @returns config value
+      @returns config value, valid until entry is changed. Use copyValue from other tasks
     */
     const char * get(const char * name);
+    /*
+      Get config entry itself, entries live until reboot
+      @param name system name
+      @returns entry or nullptr if not found
+    */
+    ConfigEntry * getEntry(const char * name);
+    /*
+      Copy entry value, can be called from any task while config is changed
+      @param entry entry given by getEntry
+      @param target string to copy value into
+    */
+    void copyValue(const ConfigEntry * entry, String &target);
     int getInt(const char * name, int defaultValue = 0);
     bool getBool(const char * name, bool defaultValue = false);
     /*
@@ -85,19 +98,26 @@ class ConfigManagerClass {
       @param handler lambda with handler logic
     */
     void onConfigUpdate(ConfigUpdatedHook handler);
+    /*
+      Incremented on every entry add or value change.
+      Lets cached values (hook templates) know they are stale.
+    */
+    uint32_t version() { return _version; }
 
     void loadConfigValues();
     bool setConfig(JsonDocument conf);
     bool dropConfig();
     String getConfigJson();
   private:
-    std::list<ConfigEntry*> _config;
+    Registry<ConfigEntry, STATIC_REGISTRY_MAX_CONFIG> _config;
     ConfigUpdatedHook _configUpdatedHook = [](){};
+    uint32_t _version = 0;
+    // guards entries list and values against readers from other tasks (hook templates)
+    Lock _lock;
   
     bool saveConfig();
     bool setConfigValueWithoutSave(const char * name, const char * value);
     void callConfigUpdateHook();
-    std::list<ConfigEntry*>::iterator findConfigEntry(const char * name);
 };
 
 extern ConfigManagerClass ConfigManager;
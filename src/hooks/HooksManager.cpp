@@ -2,6 +2,7 @@
 
 #if ENABLE_HOOKS
 
+#include <algorithm>
 #include <type_traits>
 
 #include "sensors/SensorsManager.h"
@@ -17,27 +18,30 @@
   const char * const _errorNoSuchSensor = "No such sensor";
 #endif
 
+/*
+  First byte of hooks section, then [sensor name][hooks count][hook records] for each sensor.
+  Hooks in text format of older versions start with sensor name and are migrated on load.
+*/
+#define HOOKS_STORAGE_VERSION 0x01
+
 HooksManagerClass HooksManager;
 
 int HooksManagerClass::add(const char * sensorName, const char * data) {
-  SensorType type = SensorsManager.getSensorType(sensorName);
-  if (type == UNKNOWN_SENSOR) {
-    st_log_error(_HOOKS_MANAGER_TAG, _errorNoSuchSensor);
-    return -1;
-  }
-
-  #if ENABLE_TEXT_SENSORS
-  if (type == TEXT_SENSOR) {
-    return HooksManager.add<TEXT_SENSOR_DATA_TYPE>(SensorsManager.getSensor<TEXT_SENSOR_DATA_TYPE>(sensorName), data);
+  LockGuard guard(_writeLock);
+  #if ENABLE_NUMBER_SENSORS 
+  const Sensor<NUMBER_SENSOR_DATA_TYPE> * numberSensor = SensorsManager.getSensor<NUMBER_SENSOR_DATA_TYPE>(sensorName);
+  if (numberSensor != nullptr) {
+    return saveAdded<NUMBER_SENSOR_DATA_TYPE>(numberSensor, add<NUMBER_SENSOR_DATA_TYPE>(numberSensor, data));
   }
   #endif
-  #if ENABLE_NUMBER_SENSORS 
-  if (type == NUMBER_SENSOR) {
-    return HooksManager.add<NUMBER_SENSOR_DATA_TYPE>(SensorsManager.getSensor<NUMBER_SENSOR_DATA_TYPE>(sensorName), data);
+  #if ENABLE_TEXT_SENSORS
+  const Sensor<TEXT_SENSOR_DATA_TYPE> * textSensor = SensorsManager.getSensor<TEXT_SENSOR_DATA_TYPE>(sensorName);
+  if (textSensor != nullptr) {
+    return saveAdded<TEXT_SENSOR_DATA_TYPE>(textSensor, add<TEXT_SENSOR_DATA_TYPE>(textSensor, data));
   }
   #endif
   
-  st_log_error(_HOOKS_MANAGER_TAG, "This sensor type is not supported");
+  st_log_error(_HOOKS_MANAGER_TAG, _errorNoSuchSensor);
   return -1;
 }
 
@@ -87,10 +91,12 @@ int HooksManagerClass::add(const Sensor<T> *sensor, Hook<T> *hook) {
     return -1;
   }
 
-  if (!watcher->add(hook)) {
+  if (!watcher->add(hook, _rcu)) {
     st_log_error(_HOOKS_MANAGER_TAG, "Failed to add hook in watcher");
     return -1;
   }
+  // hooks lists are copied on every add, don't let them pile up on load
+  _rcu.reclaim();
   _hooksCount++;
   st_log_info(_HOOKS_MANAGER_TAG, "Added new hook(id=%d) for sensor %s", hook->getId(), sensor->name());
 
@@ -104,19 +110,24 @@ Watcher<T> *HooksManagerClass::getWatcherOrCreate(const Sensor<T> *sensor) {
     return nullptr;
   }
 
-  auto it = getWatcherBySensorName<T>(sensor->name());
-  if (it == getWatchersList<T>()->end()) {
+  Watcher<T> *watcher = getWatcherBySensorName<T>(sensor->name());
+  if (watcher == nullptr) {
     st_log_debug(_HOOKS_MANAGER_TAG, "Creating new watcher for sensor %s", sensor->name());
-    Watcher<T> *watcher = new Watcher<T>(sensor);
-    getWatchersList<T>()->push_back(watcher);
+    watcher = new Watcher<T>(sensor);
+    if (sensor->isPush()) {
+      // push sensors are skipped by periodic check, so take initial value now
+      watcher->check();
+    }
+    std::vector<Watcher<T>*> watchers = getWatchers<T>()->load()->watchers;
+    watchers.push_back(watcher);
+    publishWatchers<T>(watchers);
     st_log_debug(_HOOKS_MANAGER_TAG, "Added new watcher for sensor %s", sensor->name());
-    return watcher;
-  } else {
-    return *it;
   }
+  return watcher;
 }
 
 bool HooksManagerClass::remove(const char * name, int id) {
+  LockGuard guard(_writeLock);
   SensorType type = SensorsManager.getSensorType(name);
   if (type == UNKNOWN_SENSOR) {
     st_log_error(_HOOKS_MANAGER_TAG, _errorNoSuchSensor);
@@ -125,12 +136,12 @@ bool HooksManagerClass::remove(const char * name, int id) {
 
   #if ENABLE_NUMBER_SENSORS
   if (type == NUMBER_SENSOR) {
-    return remove<NUMBER_SENSOR_DATA_TYPE>(name, id);
+    return removeAndSave<NUMBER_SENSOR_DATA_TYPE>(name, id);
   } 
   #endif
   #if ENABLE_TEXT_SENSORS
   if (type == TEXT_SENSOR) {
-    return remove<TEXT_SENSOR_DATA_TYPE>(name, id);
+    return removeAndSave<TEXT_SENSOR_DATA_TYPE>(name, id);
   }
   #endif
 
@@ -141,13 +152,12 @@ bool HooksManagerClass::remove(const char * name, int id) {
 template <typename T>
 bool HooksManagerClass::remove(const char *name, int id) {
   st_log_warning(_HOOKS_MANAGER_TAG, "Trying to delete sensor [%s]'s hook id=%d", name, id);
-  auto it = getWatcherBySensorName<T>(name);
-  if (it == getWatchersList<T>()->end()) {
+  Watcher<T> * watcher = getWatcherBySensorName<T>(name);
+  if (watcher == nullptr) {
     return false;
   }
   
-  Watcher<T> * watcher = *it;
-  if (!watcher->removeHook(id)) {
+  if (!watcher->removeHook(id, _rcu)) {
     return false;
   }
 
@@ -155,20 +165,77 @@ bool HooksManagerClass::remove(const char *name, int id) {
   st_log_warning(_HOOKS_MANAGER_TAG,
                  "Hook № %d of sensor [%s] was deleted", id, name);
   if (watcher->haveHooks()) {
+    _rcu.reclaim();
     return true;
   }
   st_log_debug(_HOOKS_MANAGER_TAG,
                "No hooks left for sensor [%s], removing watcher!",
                name);
 
-  delete watcher;
-  getWatchersList<T>()->erase(it);
+  std::vector<Watcher<T>*> watchers = getWatchers<T>()->load()->watchers;
+  watchers.erase(std::find(watchers.begin(), watchers.end(), watcher));
+  publishWatchers<T>(watchers);
+  _rcu.retire(watcher);
+  _rcu.reclaim();
 
   st_log_warning(_HOOKS_MANAGER_TAG, "Watcher for sensor [%s] removed!", name);
   return true;
 }
 
+template <typename T>
+int HooksManagerClass::saveAdded(const Sensor<T> *sensor, int id) {
+  if (id < 0 || save()) {
+    return id;
+  }
+  st_log_error(_HOOKS_MANAGER_TAG, "Failed to save hooks, removing new hook id=%d for sensor [%s]", id, sensor->name());
+  remove<T>(sensor->name(), id);
+  return -1;
+}
+
+template <typename T>
+bool HooksManagerClass::removeAndSave(const char *name, int id) {
+  Hook<T> *hook = getHookFromWatcher<T>(name, id);
+  Hook<T> *copy = nullptr;
+  if (hook != nullptr && !hook->isReadonly()) {
+    copy = copyHook<T>(hook);
+    if (copy == nullptr) {
+      st_log_error(_HOOKS_MANAGER_TAG, "Failed to copy hook id=%d for sensor [%s]", id, name);
+      return false;
+    }
+  }
+
+  if (!remove<T>(name, id)) {
+    delete copy;
+    return false;
+  }
+  if (save()) {
+    delete copy;
+    return true;
+  }
+
+  // restored hook goes to the end of sensor's hooks list
+  st_log_error(_HOOKS_MANAGER_TAG, "Failed to save hooks, restoring hook id=%d for sensor [%s]", id, name);
+  if (add<T>(SensorsManager.getSensor<T>(name), copy) < 0) {
+    delete copy;
+  }
+  return false;
+}
+
+template <typename T>
+Hook<T> *HooksManagerClass::copyHook(Hook<T> *hook) {
+  ByteWriter out;
+  hook->serialize(out);
+  ByteReader reader(out.data(), out.length());
+  ByteReader record = reader.readRecord();
+  Hook<T> *copy = HooksBuilder::build<T>(record);
+  if (copy != nullptr) {
+    copy->takeStateFrom(hook);
+  }
+  return copy;
+}
+
 bool HooksManagerClass::update(JsonDocument doc) {
+  LockGuard guard(_writeLock);
   const char * sensor = doc["sensor"];
   SensorType type = SensorsManager.getSensorType(sensor);
   if (type == UNKNOWN_SENSOR) {
@@ -210,11 +277,12 @@ bool HooksManagerClass::update(const char *name, JsonDocument &hookObject) {
   }
 
   int id = hookObject[_idHookField];
-  Hook<T> *hook = getHookFromWatcher<T>(name, id);
-  if (hook == nullptr) {
+  Watcher<T> *watcher = getWatcherBySensorName<T>(name);
+  Hook<T> *current = getHookFromWatcher<T>(name, id);
+  if (watcher == nullptr || current == nullptr) {
     return false;
   }
-  if (hook->isReadonly()) {
+  if (current->isReadonly()) {
     st_log_error(_HOOKS_MANAGER_TAG,
                  "Hook id=%d for sensor [%s] is readonly!", id, name);
     return false;
@@ -222,6 +290,17 @@ bool HooksManagerClass::update(const char *name, JsonDocument &hookObject) {
 
   st_log_info(_HOOKS_MANAGER_TAG, "Trying to update hook id=%d for sensor [%s]", id, name);
 
+  // published hook can be checked by loop task right now, so changes go to its copy
+  Hook<T> *hook = copyHook<T>(current);
+  // and the other copy is put back if changed hooks can't be saved
+  Hook<T> *backup = copyHook<T>(current);
+  if (hook == nullptr || backup == nullptr) {
+    st_log_error(_HOOKS_MANAGER_TAG, "Failed to copy hook id=%d for sensor [%s]", id, name);
+    delete hook;
+    delete backup;
+    return false;
+  }
+
   if (hookObject[_triggerEnabledHookField].is<bool>()) {
     bool enabled = hookObject[_triggerEnabledHookField].as<bool>();
     hook->setTriggerEnabled(enabled);
@@ -236,20 +315,37 @@ bool HooksManagerClass::update(const char *name, JsonDocument &hookObject) {
   );
 
   HooksBuilder::parseTrigger(hook, hookObject);
-
   hook->updateCustom(hookObject);
 
+  if (!watcher->replaceHook(current, hook, _rcu)) {
+    st_log_error(_HOOKS_MANAGER_TAG, "Failed to replace hook id=%d for sensor [%s]", id, name);
+    delete hook;
+    delete backup;
+    return false;
+  }
+  if (!save()) {
+    st_log_error(_HOOKS_MANAGER_TAG, "Failed to save hooks, restoring hook id=%d for sensor [%s]", id, name);
+    backup->takeStateFrom(hook);
+    if (!watcher->replaceHook(hook, backup, _rcu)) {
+      delete backup;
+    }
+    _rcu.reclaim();
+    return false;
+  }
+  delete backup;
+  _rcu.reclaim();
+
   st_log_info(_HOOKS_MANAGER_TAG, "Hook id=%d for sensor [%s] was updated!", id, name);
   return true;
 }
 
 template <typename T>
 Hook<T> *HooksManagerClass::getHookFromWatcher(const char *name, int id) {
-  auto watcher = getWatcherBySensorName<T>(name);
-  if (watcher == getWatchersList<T>()->end()) {
+  Watcher<T> *watcher = getWatcherBySensorName<T>(name);
+  if (watcher == nullptr) {
     return nullptr;
   }
-  Hook<T> *hook = (*watcher)->getHookById(id);
+  Hook<T> *hook = watcher->getHookById(id);
   if (hook == nullptr) {
     st_log_warning(_HOOKS_MANAGER_TAG, "Can't find hook id=%d for sensor [%s]", id, name);
     return nullptr;
@@ -257,36 +353,132 @@ Hook<T> *HooksManagerClass::getHookFromWatcher(const char *name, int id) {
   return hook;
 }
 
+// Must be called in read section or by writer
 template <typename T>
-typename std::list<Watcher<T>*>::iterator HooksManagerClass::getWatcherBySensorName(const char *name) {
-  std::list<Watcher<T>*> * list = getWatchersList<T>();
-  return std::find_if(list->begin(), list->end(), [name](const Watcher<T> * watcher) {
-    return strcmp(watcher->getSensor()->name(), name) == 0;
-  });
+Watcher<T> *HooksManagerClass::getWatcherBySensorName(const char *name) {
+  return getWatchers<T>()->load()->index.find(name);
 }
 
 void HooksManagerClass::check() {
-  #if ENABLE_NUMBER_SENSORS 
-  if (_sensorsWatchers.size() > 0) {
-    checkWatchers<NUMBER_SENSOR_DATA_TYPE>();
+  unsigned long started = micros();
+  unsigned long now = millis();
+  uint16_t calls = 0;
+  uint16_t checked = 0;
+
+  {
+    RcuReadGuard guard(_rcu);
+    #if ENABLE_NUMBER_SENSORS 
+    calls += checkWatchers<NUMBER_SENSOR_DATA_TYPE>(now, checked);
+    #endif
+    #if ENABLE_TEXT_SENSORS
+    calls += checkWatchers<TEXT_SENSOR_DATA_TYPE>(now, checked);
+    #endif
   }
-  #endif
-  #if ENABLE_TEXT_SENSORS
-  if (_statesWatchers.size() > 0) {
-    checkWatchers<TEXT_SENSOR_DATA_TYPE>();
+  // garbage left by writes which found loop task in read section, writer never waits for it
+  if (_rcu.hasRetired() && _writeLock.tryLock()) {
+    _rcu.reclaim();
+    _writeLock.unlock();
   }
-  #endif
+
+  unsigned long duration = micros() - started;
+  if (duration > _maxCheckTime) {
+    _maxCheckTime = duration;
+  }
+  // most ticks find no due watcher, they would hide the time of real checks
+  if (checked > 0) {
+    _lastCheckTime = duration;
+    _lastCheckWatchers = checked;
+  }
+  if (calls > 0) {
+    _lastFiredCheckTime = duration;
+    _lastFiredCheckCalls = calls;
+  }
+}
+
+template <typename T>
+bool laterCheck(const Watcher<T> * a, const Watcher<T> * b) {
+  return (long) (a->nextCheck() - b->nextCheck()) > 0;
+}
+
+template <typename T>
+uint16_t HooksManagerClass::checkWatchers(unsigned long now, uint16_t &checked) {
+  uint16_t calls = 0;
+  syncQueue<T>(getWatchers<T>()->load());
+  std::vector<Watcher<T>*> * queue = &getWatchersQueue<T>()->heap;
+  // only due watchers are touched, queue top is the nearest one
+  while (!queue->empty()) {
+    Watcher<T> * watcher = queue->front();
+    if ((long) (now - watcher->nextCheck()) < 0) {
+      break;
+    }
+    std::pop_heap(queue->begin(), queue->end(), laterCheck<T>);
+    checked++;
+    // checks are sensor's sampling schedule: sample taken by another reader after previous check
+    // would be reused almost one interval old, unless max age allows older values
+    const Sensor<T> * sensor = watcher->getSensor();
+    if (sensor->maxAge() <= sensor->interval()) {
+      sensor->invalidate();
+    }
+    if (watcher->check()) {
+      calls += watcher->lastCalled();
+    }
+    watcher->scheduleNext(now);
+    std::push_heap(queue->begin(), queue->end(), laterCheck<T>);
+  }
+  return calls;
 }
 
 template <typename T>
-void HooksManagerClass::checkWatchers() {
-  std::list<Watcher<T>*> * list = getWatchersList<T>();
-  for (auto it = list->begin(); it != list->end(); ++it) {
-    (*it)->check();
+void HooksManagerClass::syncQueue(const WatchersSnapshot<T> * snapshot) {
+  WatchersQueue<T> * queue = getWatchersQueue<T>();
+  if (queue->version == snapshot->version) {
+    return;
   }
+  // old heap may point to deleted watchers, so it's rebuilt without touching them
+  queue->heap.clear();
+  for (Watcher<T> * watcher : snapshot->watchers) {
+    if (!watcher->getSensor()->isPush()) {
+      queue->heap.push_back(watcher);
+    }
+  }
+  std::make_heap(queue->heap.begin(), queue->heap.end(), laterCheck<T>);
+  queue->version = snapshot->version;
+}
+
+template <typename T>
+void HooksManagerClass::publishWatchers(const std::vector<Watcher<T>*> &watchers) {
+  WatchersSnapshot<T> * next = new WatchersSnapshot<T>();
+  next->watchers = watchers;
+  for (Watcher<T> * watcher : watchers) {
+    next->index.put(watcher);
+  }
+  next->version = ++_watchersVersion;
+
+  RcuPointer<WatchersSnapshot<T>> * current = getWatchers<T>();
+  WatchersSnapshot<T> * old = current->load();
+  current->publish(next);
+  _rcu.retire(old);
+}
+
+bool HooksManagerClass::check(const char * name) {
+  RcuReadGuard guard(_rcu);
+  #if ENABLE_NUMBER_SENSORS
+    Watcher<NUMBER_SENSOR_DATA_TYPE> * numberWatcher = getWatcherBySensorName<NUMBER_SENSOR_DATA_TYPE>(name);
+    if (numberWatcher != nullptr) {
+      return numberWatcher->check();
+    }
+  #endif
+  #if ENABLE_TEXT_SENSORS
+    Watcher<TEXT_SENSOR_DATA_TYPE> * textWatcher = getWatcherBySensorName<TEXT_SENSOR_DATA_TYPE>(name);
+    if (textWatcher != nullptr) {
+      return textWatcher->check();
+    }
+  #endif
+  return false;
 }
 
 boolean HooksManagerClass::call(const char * name, int id, String value) {
+  RcuReadGuard guard(_rcu);
   SensorType type = SensorsManager.getSensorType(name);
   if (type == UNKNOWN_SENSOR) {
     st_log_error(_HOOKS_MANAGER_TAG, _errorNoSuchSensor);
@@ -319,13 +511,12 @@ boolean HooksManagerClass::call(const char * name, int id, String value) {
 
 template <typename T>
 boolean HooksManagerClass::callWatcherHook(const char * name, int id, T value, boolean emptyValue) {
-  auto it = getWatcherBySensorName<T>(name);
-  if (it == getWatchersList<T>()->end()) {
+  Watcher<T> * watcher = getWatcherBySensorName<T>(name);
+  if (watcher == nullptr) {
     st_log_error(_HOOKS_MANAGER_TAG, "Can't find watcher for sensor with name=%s", name);
     return false;
   }
-  Watcher<T> * watcher = *it;
-  Hook<T> * hook = watcher->getHookById(id);
+  Hook<T> * hook = watcher->findHook(id);
   if (hook == nullptr) {
     st_log_error(_HOOKS_MANAGER_TAG, "Can't find hook for sensor %s by id=%d", name, id);
     return false;
@@ -347,19 +538,100 @@ boolean HooksManagerClass::callWatcherHook(const char * name, int id, T value, b
 }
 
 void HooksManagerClass::loadFromSettings() {
-  String fromSettings = SettingsRepository.getHooks();
+  LockGuard guard(_writeLock);
+  bool failedBuild = false, legacy = false, empty = true;
 
-  if (fromSettings.isEmpty()) {
+  st_log_debug(_HOOKS_MANAGER_TAG, "Building hooks from settings");
+  bool read = SettingsRepository.readHooks([&](const uint8_t * data, size_t length) {
+    if (length == 0) {
+      return;
+    }
+    empty = false;
+    if (data[0] != HOOKS_STORAGE_VERSION) {
+      legacy = true;
+      failedBuild = loadLegacyHooks((const char *) data, length);
+      return;
+    }
+    ByteReader reader(data + 1, length - 1);
+    failedBuild = loadHooks(reader);
+  });
+
+  if (!read || empty) {
     st_log_info(_HOOKS_MANAGER_TAG, "No hooks in settings");
     return;
   }
 
+  st_log_debug(_HOOKS_MANAGER_TAG, "Hooks loaded! Total count: %d", _hooksCount);
+
+  if (legacy) {
+    st_log_warning(_HOOKS_MANAGER_TAG, "Migrating hooks from text format");
+    save();
+  } else if (failedBuild) {
+    st_log_warning(_HOOKS_MANAGER_TAG, "Have some ghost hooks to delete (Failed build). Trying to save correct hooks list");
+    if (save()) {
+      st_log_warning(_HOOKS_MANAGER_TAG, "Ghost hooks removed");
+    }
+  }
+}
+
+bool HooksManagerClass::loadHooks(ByteReader &reader) {
+  bool failedBuild = false;
+  while (!reader.atEnd()) {
+    const char * name = reader.readString();
+    uint32_t count = reader.readVarint();
+    if (reader.failed()) {
+      st_log_error(_HOOKS_MANAGER_TAG, "Hooks data is corrupted");
+      return true;
+    }
+
+    SensorType type = SensorsManager.getSensorType(name);
+    #if ENABLE_NUMBER_SENSORS
+    if (type == NUMBER_SENSOR) {
+      failedBuild = loadHooks<NUMBER_SENSOR_DATA_TYPE>(SensorsManager.getSensor<NUMBER_SENSOR_DATA_TYPE>(name), reader, count) || failedBuild;
+      continue;
+    }
+    #endif
+    #if ENABLE_TEXT_SENSORS
+    if (type == TEXT_SENSOR) {
+      failedBuild = loadHooks<TEXT_SENSOR_DATA_TYPE>(SensorsManager.getSensor<TEXT_SENSOR_DATA_TYPE>(name), reader, count) || failedBuild;
+      continue;
+    }
+    #endif
+
+    // records are length-prefixed, so hooks of unknown sensor are just skipped
+    st_log_error(_HOOKS_MANAGER_TAG, "Can't find sensor %s, skipping its hooks", name);
+    for (uint32_t i = 0; i < count && !reader.failed(); i++) {
+      reader.readRecord();
+    }
+  }
+  return failedBuild || reader.failed();
+}
+
+template<typename T>
+bool HooksManagerClass::loadHooks(const Sensor<T> * sensor, ByteReader &reader, uint32_t count) {
+  bool failedBuild = false;
+  for (uint32_t i = 0; i < count; i++) {
+    ByteReader record = reader.readRecord();
+    if (reader.failed()) {
+      st_log_error(_HOOKS_MANAGER_TAG, "Hooks data is corrupted");
+      return true;
+    }
+    Hook<T> * hook = HooksBuilder::build<T>(record);
+    if (hook == nullptr || add<T>(sensor, hook) == -1) {
+      st_log_error(_HOOKS_MANAGER_TAG, "Failed to build hook for sensor %s", sensor->name());
+      if (hook != nullptr) {
+        delete hook;
+      }
+      failedBuild = true;
+    }
+  }
+  return failedBuild;
+}
+
+bool HooksManagerClass::loadLegacyHooks(const char * data, int dataLength) {
   bool failedBuild = false;
   int address = 0;
-  int dataLength = fromSettings.length();
-  const char * data = fromSettings.c_str();
 
-  st_log_debug(_HOOKS_MANAGER_TAG, "Building hooks from settings");
   while(address < dataLength) {
     String name;
 
@@ -376,37 +648,29 @@ void HooksManagerClass::loadFromSettings() {
     if (type == UNKNOWN_SENSOR) {
       st_log_error(_HOOKS_MANAGER_TAG, "Can't find sensor %s", name.c_str());
       st_log_error(_HOOKS_MANAGER_TAG, "FAILED TO LOAD HOOKS FROM SETTINGS");
-      return;
+      return failedBuild;
     }
 
     #if ENABLE_NUMBER_SENSORS
     if (type == NUMBER_SENSOR) {
-      failedBuild = loadHooks<NUMBER_SENSOR_DATA_TYPE>(SensorsManager.getSensor<NUMBER_SENSOR_DATA_TYPE>(name.c_str()), data, &address, dataLength) || failedBuild;
+      failedBuild = loadLegacyHooks<NUMBER_SENSOR_DATA_TYPE>(SensorsManager.getSensor<NUMBER_SENSOR_DATA_TYPE>(name.c_str()), data, &address, dataLength) || failedBuild;
     }
     #endif
     #if ENABLE_TEXT_SENSORS
     if (type == TEXT_SENSOR) {
-      failedBuild = loadHooks<TEXT_SENSOR_DATA_TYPE>(SensorsManager.getSensor<TEXT_SENSOR_DATA_TYPE>(name.c_str()), data, &address, dataLength) || failedBuild;
+      failedBuild = loadLegacyHooks<TEXT_SENSOR_DATA_TYPE>(SensorsManager.getSensor<TEXT_SENSOR_DATA_TYPE>(name.c_str()), data, &address, dataLength) || failedBuild;
     }
     #endif
 
     address++;
   }
-
-  st_log_debug(_HOOKS_MANAGER_TAG, "Hooks loaded! Total count: %d", _hooksCount);
-
-  if (failedBuild) {
-    st_log_warning(_HOOKS_MANAGER_TAG, "Have some ghost hooks to delete (Failed build). Trying to save correct hooks list");
-    if (saveInSettings()) {
-      st_log_warning(_HOOKS_MANAGER_TAG, "Ghost hooks removed");
-    }
-  }
+  return failedBuild;
 }
 
 template<typename T>
-bool HooksManagerClass::loadHooks(const Sensor<T> * sensor, const char * data, int * address, int length) {
+bool HooksManagerClass::loadLegacyHooks(const Sensor<T> * sensor, const char * data, int * address, int length) {
   bool res = false;
-  String buff; // todo remove, pass hook length
+  String buff;
 
   for (; (*address) < length; (*address)++) {
     if (data[(*address)] == '\t' || data[(*address)] == '\n') {
@@ -425,28 +689,31 @@ bool HooksManagerClass::loadHooks(const Sensor<T> * sensor, const char * data, i
 }
 
 bool HooksManagerClass::saveInSettings() {
+  LockGuard guard(_writeLock);
+  return save();
+}
+
+bool HooksManagerClass::save() {
   st_log_debug(_HOOKS_MANAGER_TAG, "Saving hooks");
-  String data = "";
+  ByteWriter out;
+  out.writeByte(HOOKS_STORAGE_VERSION);
 
   #if ENABLE_TEXT_SENSORS
-    std::list<Watcher<TEXT_SENSOR_DATA_TYPE>*>::iterator itt;
-    for (itt = _statesWatchers.begin(); itt != _statesWatchers.end(); ++itt) {
-      data += (*itt)->toString();
-      data += "\n";
+    for (Watcher<TEXT_SENSOR_DATA_TYPE> * watcher : _statesWatchers.load()->watchers) {
+      watcher->serialize(out);
     }
   #endif
   #if ENABLE_NUMBER_SENSORS 
-    std::list<Watcher<NUMBER_SENSOR_DATA_TYPE>*>::iterator itn;
-    for (itn = _sensorsWatchers.begin(); itn != _sensorsWatchers.end(); ++itn) {
-      data += (*itn)->toString();
-      data += "\n";
+    for (Watcher<NUMBER_SENSOR_DATA_TYPE> * watcher : _sensorsWatchers.load()->watchers) {
+      watcher->serialize(out);
     }
   #endif
 
-  return SettingsRepository.setHooks(data);
+  return SettingsRepository.setHooks(out.data(), out.length());
 }
 
 JsonDocument HooksManagerClass::getSensorHooksJson(const char *name) {
+  RcuReadGuard guard(_rcu);
   JsonDocument doc;
 
   if (name == nullptr || strlen(name) == 0) {
@@ -481,9 +748,9 @@ JsonDocument HooksManagerClass::getSensorHooksJson(const char *name) {
   if (name == nullptr || strlen(name) == 0) {
     st_log_error(_HOOKS_MANAGER_TAG, "Name of sensor is missing!");
   } else {
-    auto it = getWatcherBySensorName<T>(name);
-    if (it != getWatchersList<T>()->end()) {
-      return (*it)->getSensorHooksJson();
+    Watcher<T> * watcher = getWatcherBySensorName<T>(name);
+    if (watcher != nullptr) {
+      return watcher->getSensorHooksJson();
     }
   }
   JsonDocument doc;
@@ -492,16 +759,26 @@ JsonDocument HooksManagerClass::getSensorHooksJson(const char *name) {
 
 #if ENABLE_TEXT_SENSORS
   template <>
-  std::list<Watcher<TEXT_SENSOR_DATA_TYPE>*> *HooksManagerClass::getWatchersList() {
+  RcuPointer<HooksManagerClass::WatchersSnapshot<TEXT_SENSOR_DATA_TYPE>> *HooksManagerClass::getWatchers() {
     return &_statesWatchers;
   }
+
+  template <>
+  HooksManagerClass::WatchersQueue<TEXT_SENSOR_DATA_TYPE> *HooksManagerClass::getWatchersQueue() {
+    return &_statesWatchersQueue;
+  }
 #endif
 
 #if ENABLE_NUMBER_SENSORS
   template <>
-  std::list<Watcher<NUMBER_SENSOR_DATA_TYPE>*> *HooksManagerClass::getWatchersList() {
+  RcuPointer<HooksManagerClass::WatchersSnapshot<NUMBER_SENSOR_DATA_TYPE>> *HooksManagerClass::getWatchers() {
     return &_sensorsWatchers;
   }
+
+  template <>
+  HooksManagerClass::WatchersQueue<NUMBER_SENSOR_DATA_TYPE> *HooksManagerClass::getWatchersQueue() {
+    return &_sensorsWatchersQueue;
+  }
 #endif
 
 #endif
\ No newline at end of file
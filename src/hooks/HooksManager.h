@@ -6,44 +6,115 @@
 
 #include <ArduinoJson.h>
 #include <functional>
-#include <list>
+#include <vector>
 
+#include "hooks/dispatcher/HooksDispatcher.h"
+#include "hooks/dispatcher/NotificationsBatcher.h"
+#include "net/http/HttpConnectionPool.h"
 #include "hooks/impls/Hook.h"
 #include "hooks/impls/LambdaHook.h"
 #include "hooks/watcher/Watcher.h"
 #include "sensors/Sensor.h"
-
+#include "utils/ByteStream.h"
+#include "utils/Lock.h"
+#include "utils/NameIndex.h"
+#include "utils/Rcu.h"
+
+/*
+  Hooks are changed by web server task and checked by loop task (and SensorsManager.notify callers).
+  Checks run in RCU read sections over published watchers and hooks lists and never wait.
+  Changes are serialized by writer lock, they publish new lists and
+  retired hooks, watchers and lists are deleted after grace period.
+*/
 class HooksManagerClass {
  public:
   void loadFromSettings();
 
+  /*
+    Add, remove and update save hooks in settings.
+    If hooks can't be saved (e.g. they don't fit in settings storage),
+    the change is reverted and the call fails.
+  */
   int add(const char * sensorName, const char * data);
 
   bool remove(const char* name, int id);
   bool update(JsonDocument doc);
 
+  // Checks watchers which sensors sampling interval passed
   void check();
+  // Checks only watcher of given sensor
+  bool check(const char * name);
   boolean call(const char * name, int id, String value);
 
   JsonDocument getSensorHooksJson(const char* name);
 
   bool saveInSettings();
 
-  int16_t getTotalHooksCount() { return _hooksCount; }
+  uint16_t getTotalHooksCount() { return _hooksCount; }
+  // Duration of the last check() call which called some hooks in microseconds
+  unsigned long getLastFiredCheckTime() { return _lastFiredCheckTime; }
+  // Hooks called during that check() call
+  uint16_t getLastFiredCheckCalls() { return _lastFiredCheckCalls; }
+  // Duration of the last check() call which checked some watchers in microseconds
+  unsigned long getLastCheckTime() { return _lastCheckTime; }
+  // Watchers checked during that check() call
+  uint16_t getLastCheckWatchers() { return _lastCheckWatchers; }
+  // Longest check() call since boot in microseconds
+  unsigned long getMaxCheckTime() { return _maxCheckTime; }
 
  private:
+  // Published list of watchers, never changed after publish
+  template <typename T>
+  struct WatchersSnapshot {
+    std::vector<Watcher<T>*> watchers;
+    NameIndex<Watcher<T>> index;
+    uint32_t version = 0;
+  };
+
+  // Owned by the task calling check()
+  template <typename T>
+  struct WatchersQueue {
+    // min-heap by next check time, push sensors are not here
+    std::vector<Watcher<T>*> heap;
+    // version of watchers snapshot heap was built from
+    uint32_t version = 0;
+  };
+
   #if ENABLE_NUMBER_SENSORS 
-  std::list<Watcher<NUMBER_SENSOR_DATA_TYPE>*> _sensorsWatchers;
+  RcuPointer<WatchersSnapshot<NUMBER_SENSOR_DATA_TYPE>> _sensorsWatchers{new WatchersSnapshot<NUMBER_SENSOR_DATA_TYPE>()};
+  WatchersQueue<NUMBER_SENSOR_DATA_TYPE> _sensorsWatchersQueue;
   #endif
 
   #if ENABLE_TEXT_SENSORS
-  std::list<Watcher<TEXT_SENSOR_DATA_TYPE>*> _statesWatchers;
+  RcuPointer<WatchersSnapshot<TEXT_SENSOR_DATA_TYPE>> _statesWatchers{new WatchersSnapshot<TEXT_SENSOR_DATA_TYPE>()};
+  WatchersQueue<TEXT_SENSOR_DATA_TYPE> _statesWatchersQueue;
   #endif
 
-  int _hooksCount = 0;
+  RcuDomain _rcu;
+  // serializes add, remove, update, load and save
+  Lock _writeLock;
+  uint32_t _watchersVersion = 0;
+
+  uint16_t _hooksCount = 0;
+  unsigned long _lastFiredCheckTime = 0;
+  uint16_t _lastFiredCheckCalls = 0;
+  unsigned long _lastCheckTime = 0;
+  uint16_t _lastCheckWatchers = 0;
+  unsigned long _maxCheckTime = 0;
+
+  // Builds hooks from storage records, returns true if some hooks failed to build
+  bool loadHooks(ByteReader &reader);
+
+  template<typename T>
+  bool loadHooks(const Sensor<T> * sensor, ByteReader &reader, uint32_t count);
+
+  // Text format of older firmware versions, returns true if some hooks failed to build
+  bool loadLegacyHooks(const char * data, int dataLength);
 
   template<typename T>
-  bool loadHooks(const Sensor<T> * sensor, const char * data, int * address, int length);
+  bool loadLegacyHooks(const Sensor<T> * sensor, const char * data, int * address, int length);
+
+  bool save();
 
   template<typename T>
   int add(const Sensor<T> * sensor, const char * data);
@@ -52,7 +123,7 @@ class HooksManagerClass {
   int add(const Sensor<T>* obj, Hook<T>* hook);
 
   template <typename T>
-  typename std::list<Watcher<T>*>::iterator getWatcherBySensorName(const char* name);
+  Watcher<T>* getWatcherBySensorName(const char* name);
 
   template <typename T>
   Hook<T>* getHookFromWatcher(const char* name, int id);
@@ -63,11 +134,36 @@ class HooksManagerClass {
   template <typename T>
   bool remove(const char* name, int id);
 
+  // Saves hooks after hook with id was added, the hook is removed if save failed
+  template <typename T>
+  int saveAdded(const Sensor<T>* sensor, int id);
+
+  // Removes hook and saves hooks, the hook is put back if save failed
+  template <typename T>
+  bool removeAndSave(const char* name, int id);
+
+  // Builds unpublished copy of hook with its state
+  template <typename T>
+  Hook<T>* copyHook(Hook<T>* hook);
+
   template <typename T>
   bool update(const char* name, JsonDocument &hookObject);
 
+  /*
+    Check due watchers
+    @param checked incremented for every checked watcher
+    @returns count of called hooks
+  */
   template <typename T>
-  void checkWatchers();
+  uint16_t checkWatchers(unsigned long now, uint16_t &checked);
+
+  // Rebuilds check queue if watchers list was changed
+  template <typename T>
+  void syncQueue(const WatchersSnapshot<T> * snapshot);
+
+  // Publish new watchers list and retire current one, writer only
+  template <typename T>
+  void publishWatchers(const std::vector<Watcher<T>*> &watchers);
 
   template <typename T>
   boolean callWatcherHook(const char * name, int id, T value, boolean emptyValue);
@@ -77,7 +173,10 @@ class HooksManagerClass {
       const Sensor<T>* obj);
 
   template <typename T>
-  std::list<Watcher<T>*>* getWatchersList();
+  RcuPointer<WatchersSnapshot<T>>* getWatchers();
+
+  template <typename T>
+  WatchersQueue<T>* getWatchersQueue();
 };
 
 extern HooksManagerClass HooksManager;
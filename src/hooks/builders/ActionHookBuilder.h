@@ -23,6 +23,16 @@ class ActionHookBuilder {
     return build<T>(action);
   }
 
+  template <typename T>
+  static Hook<T>* build(ByteReader &record) {
+    const char * action = record.readString();
+    if (record.failed()) {
+      st_log_error(_ACTION_HOOK_BUILDER_TAG, "Bad action hook record");
+      return nullptr;
+    }
+    return build<T>(action);
+  }
+
   template <typename T>
   static Hook<T>* build(const char * action) {
     st_log_debug(_ACTION_HOOK_BUILDER_TAG, "Action hook data:action=%s", action);
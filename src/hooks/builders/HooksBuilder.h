@@ -35,6 +35,48 @@ const char * const HTTP_HOOK_TEMPLATE = "{\"url\":{\"required\":true},\"payload\
 
 class HooksBuilder {
   public:
+    /*
+      Builds hook from storage record (see Hook::serialize)
+      Strings are taken from record in place, nothing is copied before hook creation
+    */
+    template <typename T>
+    static Hook<T>* build(ByteReader &record) {
+      HookType type = static_cast<HookType>(record.readByte());
+      int id = record.readVarint();
+      CompareType compareType = static_cast<CompareType>(record.readByte());
+      bool triggerEnabled = record.readByte() & HOOK_FLAG_TRIGGER_ENABLED;
+      // trigger is applied after hook is created
+      ByteReader trigger = record;
+      skipTrigger<T>(record);
+
+      if (record.failed()) {
+        st_log_error(_HOOKS_BUILDER_TAG, "Bad hook record");
+        return nullptr;
+      }
+      if (type == UNKNOWN_HOOK) {
+        st_log_error(_HOOKS_BUILDER_TAG, "Unknown hook type!");
+        return nullptr;
+      }
+
+      Hook<T> * hook = buildForType<T, ByteReader &>(type, record);
+      if (hook == nullptr) {
+        return nullptr;
+      }
+      hook->setId(id);
+      hook->setCompareType(compareType);
+      hook->setTriggerEnabled(triggerEnabled);
+      hook->setReadOnly(false);
+      parseTrigger(hook, trigger);
+
+      st_log_debug(
+        _HOOKS_BUILDER_TAG,
+        "Built hook from record: type=%s, id=%d, compare_type=%d, trigger_enabled=%d",
+        hookTypeToStr(type), id, compareType, triggerEnabled
+      );
+      return hook;
+    }
+
+    // Builds hook from json or legacy text format
     template <typename T>
     static Hook<T>* build(const char * data) { // todo pass data length
       if (data == nullptr || strlen(data) == 0) {
@@ -84,7 +126,7 @@ class HooksBuilder {
         compareType = static_cast<CompareType>(data[3] - '0');
         triggerEnabled = data[4] == '1';
 
-        char idStr[] = {data[1], data[2]};
+        char idStr[] = {data[1], data[2], 0};
         id = atoi(idStr);
 
         for (dataOffset = 5; dataOffset < (int) strlen(data); dataOffset++) {
@@ -239,6 +281,30 @@ class HooksBuilder {
     }
     #endif
 
+    #if ENABLE_NUMBER_SENSORS
+    static void parseTrigger(Hook<NUMBER_SENSOR_DATA_TYPE> * hook, ByteReader &record) {
+      hook->setTriggerValue(record.readSigned());
+      ((NumberSensorHook *) hook)->setThreshold(record.readSigned());
+    }
+    #endif
+
+    #if ENABLE_TEXT_SENSORS
+    static void parseTrigger(Hook<TEXT_SENSOR_DATA_TYPE> * hook, ByteReader &record) {
+      hook->setTriggerValue(record.readString());
+    }
+    #endif
+
+    // Moves record past trigger fields
+    template <typename T>
+    static void skipTrigger(ByteReader &record) {
+      if (std::is_same<T, TEXT_SENSOR_DATA_TYPE>::value) {
+        record.readString();
+      } else {
+        record.readSigned();
+        record.readSigned();
+      }
+    }
+
     #if ENABLE_TEXT_SENSORS
     static void parseTrigger(Hook<TEXT_SENSOR_DATA_TYPE> * hook, String &trigger) {
       trigger.replace("|;", ";");
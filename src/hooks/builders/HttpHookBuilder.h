@@ -13,6 +13,19 @@ class HttpHookBuilder {
     return build<T>(doc[_urlHookField], static_cast<RequestMethod>(doc[_methodHookField].as<int>()), doc[_payloadHookField]);
   }
 
+  template <typename T>
+  static Hook<T> * build(ByteReader &record) {
+    const char * url = record.readString();
+    RequestMethod method = static_cast<RequestMethod>(record.readByte());
+    const char * payload = record.readString();
+    if (record.failed()) {
+      st_log_error(_HTTP_HOOK_BUILDER_TAG, "Bad http hook record");
+      return nullptr;
+    }
+    return build<T>(url, method, payload);
+  }
+
+  // Legacy text format: url;method;payload with escaped ';'
   template <typename T>
   static Hook<T> * build(const char * data) {
     String url, method, payload;
@@ -11,19 +11,42 @@ class NotificationHookBuilder {
     static Hook<T>* build(JsonDocument doc) {
       return build<T>(
         static_cast<NotificationType>(doc[_nftHookField].as<int>()),
-        doc[_messageHookField]
+        doc[_messageHookField].as<const char*>()
         #if !(ENABLE_CONFIG)
-          ,doc[_gatewayHookField]
+          ,doc[_gatewayHookField].as<const char*>()
         #endif
       );
     }
 
+    template <typename T>
+    static Hook<T>* build(ByteReader &record) {
+      NotificationType type = static_cast<NotificationType>(record.readByte());
+      const char * message = record.readString();
+      #if !(ENABLE_CONFIG)
+        const char * gatewayUrl = record.readString();
+      #endif
+      if (record.failed()) {
+        st_log_error(_NOTIFICATION_HOOK_BUILDER_TAG, "Bad notification hook record");
+        return nullptr;
+      }
+      return build<T>(
+        type,
+        message
+        #if !(ENABLE_CONFIG)
+          ,gatewayUrl
+        #endif
+      );
+    }
+
+    // Legacy text format: [type]message;gatewayUrl with escaped ';'
     template <typename T>
     static Hook<T> * build(const char * data) {
       #if ENABLE_CONFIG
+        String message = data + 1;
+        message.replace("|;", ";");
         return build<T>(
           static_cast<NotificationType>(data[0] - '0'),
-          data + 1
+          message.c_str()
         );
       #else
         int index = -1;
@@ -39,16 +62,20 @@ class NotificationHookBuilder {
           }
         }
 
-        if (escaped == -1) {
-          st_log_error(_NOTIFICATION_HOOK_TAG, "Bad input data - can't find ;");
+        if (index == -1) {
+          st_log_error(_NOTIFICATION_HOOK_BUILDER_TAG, "Bad input data - can't find ;");
           return nullptr;
         }
 
         String tmp = data;
+        String message = tmp.substring(1, index);
+        String gatewayUrl = tmp.substring(index + 1);
+        message.replace("|;", ";");
+        gatewayUrl.replace("|;", ";");
         return build<T>(
           static_cast<NotificationType>(data[0] - '0'),
-          tmp.substring(1, index),
-          tmp.substring(index + 1)
+          message.c_str(),
+          gatewayUrl.c_str()
         );
       #endif
     }
@@ -56,9 +83,9 @@ class NotificationHookBuilder {
     template <typename T>
     static Hook<T> * build(
       NotificationType type,
-      String message
+      const char * message
       #if !(ENABLE_CONFIG)
-        ,String gatewayUrl
+        ,const char * gatewayUrl
       #endif
     ) {
       if (type < NOTIFICATION_INFO || type > NOTIFICATION_ERROR) {
@@ -66,35 +93,33 @@ class NotificationHookBuilder {
         return nullptr;
       }
 
-      if (message.isEmpty()) {
+      if (message == nullptr || strlen(message) == 0) {
         st_log_error(_NOTIFICATION_HOOK_BUILDER_TAG, "Notification message is missing!");
         return nullptr;
       }
-      message.replace("|;", ";");
 
       #if !(ENABLE_CONFIG)
-        if (gatewayUrl.isEmpty()) {
+        if (gatewayUrl == nullptr || strlen(gatewayUrl) == 0) {
           st_log_error(_NOTIFICATION_HOOK_BUILDER_TAG, "Notification message is missing!");
           return nullptr;
         }
-        gatewayUrl.replace("|;", ";");
 
         st_log_debug(
           _NOTIFICATION_HOOK_BUILDER_TAG,
           "Notification hook data:type=%s,message=%s,gatewayUrl=%s",
           notificationTypeToStr(type),
-          message.c_str(),
-          gatewayUrl.c_str()
+          message,
+          gatewayUrl
         );
-        return new NotificationHook<T>(type, message.c_str(), gatewayUrl.c_str());
+        return new NotificationHook<T>(type, message, gatewayUrl);
       #else
         st_log_debug(
           _NOTIFICATION_HOOK_BUILDER_TAG,
           "Notification hook data:type=%s,message=%s",
           notificationTypeToStr(type),
-          message.c_str()
+          message
         );
-        return new NotificationHook<T>(type, message.c_str());
+        return new NotificationHook<T>(type, message);
       #endif
     }
 };
@@ -0,0 +1,211 @@
+#include "hooks/dispatcher/HooksDispatcher.h"
+
+#if ENABLE_HOOKS
+
+#include "logs/BetterLogger.h"
+
+const char * const _HOOKS_DISPATCHER_TAG = "hooks_dispatcher";
+
+HooksDispatcherClass HooksDispatcher;
+
+void HooksDispatcherClass::begin() {
+  #if HOOKS_DISPATCH_ASYNC
+    if (_started) {
+      return;
+    }
+    _available = xSemaphoreCreateBinary();
+    if (_available == NULL) {
+      st_log_error(_HOOKS_DISPATCHER_TAG, "Failed to create queue semaphore");
+      return;
+    }
+
+    for (uint8_t i = 0; i < HOOKS_DISPATCH_WORKERS; i++) {
+      xTaskCreate(
+        [](void * o) {
+          HooksDispatcher.work();
+        },
+        "st-hooks", HOOKS_DISPATCH_WORKER_STACK, NULL, 1, NULL
+      );
+    }
+    _started = true;
+    st_log_debug(_HOOKS_DISPATCHER_TAG, "Started %d dispatch workers", HOOKS_DISPATCH_WORKERS);
+  #endif
+}
+
+bool HooksDispatcherClass::dispatch(DispatchTarget * target, const String &value) {
+  if (target == nullptr) {
+    return false;
+  }
+
+  {
+    LockGuard guard(_lock);
+    if (target->_released) {
+      return false;
+    }
+
+    if (_size == HOOKS_DISPATCH_QUEUE_SIZE) {
+      DispatchOverflowPolicy policy = HOOKS_DISPATCH_OVERFLOW_POLICY;
+      if (policy == DISPATCH_COALESCE) {
+        for (size_t i = 0; i < _size; i++) {
+          DispatchEvent &event = _queue[(_head + i) % HOOKS_DISPATCH_QUEUE_SIZE];
+          if (event.target == target) {
+            event.value = value;
+            _dropped++;
+            return true;
+          }
+        }
+      }
+      _dropped++;
+      if (policy == DISPATCH_DROP_NEWEST) {
+        st_log_warning(_HOOKS_DISPATCHER_TAG, "Queue is full, event dropped");
+        return false;
+      }
+      _head = (_head + 1) % HOOKS_DISPATCH_QUEUE_SIZE;
+      _size--;
+    }
+
+    DispatchEvent &event = _queue[(_head + _size) % HOOKS_DISPATCH_QUEUE_SIZE];
+    event.target = target;
+    event.value = value;
+    _size++;
+    if (_size > _maxDepth) {
+      _maxDepth = _size;
+    }
+  }
+
+  #if HOOKS_DISPATCH_ASYNC
+    if (_available != NULL) {
+      xSemaphoreGive(_available);
+    }
+  #endif
+  return true;
+}
+
+bool HooksDispatcherClass::pop(DispatchEvent &event) {
+  for (size_t i = 0; i < _size; i++) {
+    DispatchEvent &found = _queue[(_head + i) % HOOKS_DISPATCH_QUEUE_SIZE];
+    // waits until another worker delivers previous event of this hook
+    if (found.target->_inFlight > 0) {
+      continue;
+    }
+    event.target = found.target;
+    event.target->_inFlight++;
+    event.value = found.value;
+
+    // events before found one are moved to its place, so queue keeps order
+    for (size_t j = i; j > 0; j--) {
+      DispatchEvent &to = _queue[(_head + j) % HOOKS_DISPATCH_QUEUE_SIZE];
+      DispatchEvent &from = _queue[(_head + j - 1) % HOOKS_DISPATCH_QUEUE_SIZE];
+      to.target = from.target;
+      to.value = from.value;
+    }
+    DispatchEvent &head = _queue[_head];
+    head.target = nullptr;
+    head.value.clear();
+    _head = (_head + 1) % HOOKS_DISPATCH_QUEUE_SIZE;
+    _size--;
+    return true;
+  }
+  return false;
+}
+
+bool HooksDispatcherClass::release(DispatchTarget * target) {
+  LockGuard guard(_lock);
+  size_t kept = 0;
+  for (size_t i = 0; i < _size; i++) {
+    DispatchEvent &event = _queue[(_head + i) % HOOKS_DISPATCH_QUEUE_SIZE];
+    if (event.target == target) {
+      continue;
+    }
+    if (kept != i) {
+      DispatchEvent &to = _queue[(_head + kept) % HOOKS_DISPATCH_QUEUE_SIZE];
+      to.target = event.target;
+      to.value = event.value;
+    }
+    kept++;
+  }
+  for (size_t i = kept; i < _size; i++) {
+    DispatchEvent &event = _queue[(_head + i) % HOOKS_DISPATCH_QUEUE_SIZE];
+    event.target = nullptr;
+    event.value.clear();
+  }
+  _size = kept;
+
+  if (target->_inFlight == 0) {
+    return true;
+  }
+  // web server can't wait for request of another task (or of the loop it interrupted on esp8266)
+  target->_released = true;
+  return false;
+}
+
+void HooksDispatcherClass::deliver(DispatchEvent &event) {
+  event.target->sendRequest(event.value);
+
+  bool drop = false, more = false;
+  {
+    LockGuard guard(_lock);
+    event.target->_inFlight--;
+    drop = event.target->_released && event.target->_inFlight == 0;
+    _delivered++;
+    more = _size > 0;
+  }
+  if (drop) {
+    delete event.target;
+  }
+  event.target = nullptr;
+
+  #if HOOKS_DISPATCH_ASYNC
+    // queued events of this hook could wait for this delivery
+    if (more) {
+      xSemaphoreGive(_available);
+    }
+  #else
+    (void) more;
+  #endif
+}
+
+size_t HooksDispatcherClass::depth() {
+  LockGuard guard(_lock);
+  return _size;
+}
+
+#if HOOKS_DISPATCH_ASYNC
+void HooksDispatcherClass::work() {
+  DispatchEvent event;
+  while (true) {
+    bool popped = false, more = false;
+    {
+      LockGuard guard(_lock);
+      popped = pop(event);
+      more = _size > 0;
+    }
+
+    if (!popped) {
+      xSemaphoreTake(_available, portMAX_DELAY);
+      continue;
+    }
+    if (more) {
+      // wake up next worker for the rest of the queue
+      xSemaphoreGive(_available);
+    }
+
+    deliver(event);
+  }
+}
+#else
+void HooksDispatcherClass::process() {
+  DispatchEvent event;
+  while (true) {
+    {
+      LockGuard guard(_lock);
+      if (!pop(event)) {
+        return;
+      }
+    }
+    deliver(event);
+  }
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef HOOKS_DISPATCHER_H
+#define HOOKS_DISPATCHER_H
+
+#include "Features.h"
+
+#if ENABLE_HOOKS
+
+#include <Arduino.h>
+
+#include "utils/Lock.h"
+
+// Max events waiting for delivery
+#ifndef HOOKS_DISPATCH_QUEUE_SIZE
+  #define HOOKS_DISPATCH_QUEUE_SIZE 16
+#endif
+
+// Worker tasks delivering events (esp32 only)
+#ifndef HOOKS_DISPATCH_WORKERS
+  #define HOOKS_DISPATCH_WORKERS 1
+#endif
+
+#ifndef HOOKS_DISPATCH_WORKER_STACK
+  #define HOOKS_DISPATCH_WORKER_STACK 8192
+#endif
+
+// What to do with new event when queue is full (see DispatchOverflowPolicy)
+#ifndef HOOKS_DISPATCH_OVERFLOW_POLICY
+  #define HOOKS_DISPATCH_OVERFLOW_POLICY DISPATCH_DROP_OLDEST
+#endif
+
+#ifdef ARDUINO_ARCH_ESP32
+  #define HOOKS_DISPATCH_ASYNC 1
+#else
+  #define HOOKS_DISPATCH_ASYNC 0
+#endif
+
+enum DispatchOverflowPolicy {
+  // drop the oldest queued event to make room for the new one
+  DISPATCH_DROP_OLDEST,
+  // drop the new event
+  DISPATCH_DROP_NEWEST,
+  // replace value of already queued event of the same hook, otherwise drop the oldest
+  DISPATCH_COALESCE
+};
+
+// Hook which delivers events outside (http request, notification)
+class DispatchTarget {
+  public:
+    virtual ~DispatchTarget() {};
+    virtual void sendRequest(String &value) = 0;
+
+  private:
+    friend class HooksDispatcherClass;
+    // guarded by dispatcher lock
+    uint8_t _inFlight = 0;
+    bool _released = false;
+};
+
+/*
+  Bounded queue of outgoing hook events.
+  On esp32 it is drained by HOOKS_DISPATCH_WORKERS long-lived tasks,
+  on esp8266 - by SmartThing.loop().
+  Hook has at most one event in delivery, so its events are delivered in order
+  and hook state is touched by one worker at a time.
+*/
+class HooksDispatcherClass {
+  public:
+    // Starts worker tasks
+    void begin();
+
+    /*
+      Queue event for delivery
+      @param target hook to deliver with
+      @param value sensor value captured at fire time
+      @returns false if event was dropped
+    */
+    bool dispatch(DispatchTarget * target, const String &value);
+
+    /*
+      Drop all queued events of target, called instead of deleting it. Never waits.
+      @returns true if target can be deleted now, otherwise it is in delivery
+        and dispatcher deletes it when delivery ends
+    */
+    bool release(DispatchTarget * target);
+
+    #if !HOOKS_DISPATCH_ASYNC
+      // Delivers queued events in caller's context
+      void process();
+    #endif
+
+    size_t depth();
+    size_t maxDepth() { return _maxDepth; }
+    unsigned long dropped() { return _dropped; }
+    unsigned long delivered() { return _delivered; }
+
+  private:
+    struct DispatchEvent {
+      DispatchTarget * target;
+      String value;
+    };
+
+    DispatchEvent _queue[HOOKS_DISPATCH_QUEUE_SIZE];
+    size_t _head = 0;
+    size_t _size = 0;
+    size_t _maxDepth = 0;
+    unsigned long _dropped = 0;
+    unsigned long _delivered = 0;
+    Lock _lock;
+
+    #if HOOKS_DISPATCH_ASYNC
+      bool _started = false;
+      SemaphoreHandle_t _available = NULL;
+
+      void work();
+    #endif
+
+    // Pops oldest event of target which is not in delivery and marks target as in delivery, lock must be held
+    bool pop(DispatchEvent &event);
+    // Delivers popped event and deletes its target if it was released meanwhile
+    void deliver(DispatchEvent &event);
+};
+
+extern HooksDispatcherClass HooksDispatcher;
+
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+#include "hooks/dispatcher/NotificationsBatcher.h"
+
+#if ENABLE_NOTIFICATIONS_BATCHING
+
+#include <ArduinoJson.h>
+
+#include "SmartThing.h"
+#include "config/ConfigManager.h"
+#include "logs/BetterLogger.h"
+#include "net/http/HttpConnectionPool.h"
+
+const char * const _NOTIFICATIONS_BATCHER_TAG = "notifications_batcher";
+
+NotificationsBatcherClass NotificationsBatcher;
+
+void NotificationsBatcherClass::add(const String &message, const char * type) {
+  unsigned long now = millis();
+  JsonDocument doc;
+  doc["message"] = message;
+  doc["type"] = type;
+  doc["ts"] = now;
+  String event;
+  serializeJson(doc, event);
+
+  bool flush = false;
+  {
+    LockGuard guard(_lock);
+    if (_pending.length() >= NOTIFICATIONS_BATCH_MAX_BYTES * 4) {
+      // flushes are stuck somewhere, don't eat all the heap
+      st_log_warning(_NOTIFICATIONS_BATCHER_TAG, "Batch is too big, notification dropped");
+      _dropped++;
+      return;
+    }
+    if (_count == 0) {
+      _firstAt = now;
+    } else {
+      _pending += ',';
+    }
+    _pending += event;
+    _count++;
+    flush = _count >= NOTIFICATIONS_BATCH_MAX_COUNT || _pending.length() >= NOTIFICATIONS_BATCH_MAX_BYTES;
+  }
+
+  if (flush) {
+    requestFlush();
+  }
+}
+
+void NotificationsBatcherClass::tick() {
+  bool flush = false;
+  {
+    LockGuard guard(_lock);
+    flush = _count > 0 && millis() - _firstAt >= NOTIFICATIONS_BATCH_MAX_LATENCY;
+  }
+  if (flush) {
+    requestFlush();
+  }
+}
+
+void NotificationsBatcherClass::requestFlush() {
+  {
+    LockGuard guard(_lock);
+    // queued flush can be dropped by dispatcher overflow policy, so request it again after a while
+    if (_flushQueued && millis() - _flushRequestedAt < NOTIFICATIONS_BATCH_MAX_LATENCY) {
+      return;
+    }
+    _flushQueued = true;
+    _flushRequestedAt = millis();
+  }
+  if (!HooksDispatcher.dispatch(this, emptyString)) {
+    LockGuard guard(_lock);
+    _flushQueued = false;
+  }
+}
+
+void NotificationsBatcherClass::sendRequest(String &value) {
+  LockGuard sendGuard(_sendLock);
+
+  String batch;
+  size_t count = 0;
+  bool retried = false;
+  {
+    LockGuard guard(_lock);
+    _flushQueued = false;
+    if (_count == 0) {
+      return;
+    }
+    batch = _pending;
+    count = _count;
+    retried = _retry;
+    _pending.clear();
+    _count = 0;
+    _retry = false;
+  }
+
+  String gateway = ConfigManager.get(GATEWAY_CONFIG);
+  if (gateway.isEmpty()) {
+    st_log_error(_NOTIFICATIONS_BATCHER_TAG, "Gateway ip is missing! %d notifications dropped", count);
+    dropBatch(count);
+    return;
+  }
+  String url = gateway.startsWith("http") ? gateway : "http://" + gateway;
+  url += "/api/notifications";
+
+  String body;
+  body.reserve(batch.length() + 96);
+  body += "{\"device\":{\"name\":\"";
+  body += SmartThing.getName();
+  body += "\",\"type\":\"";
+  body += SmartThing.getType();
+  body += "\",\"ip\":\"";
+  body += SmartThing.getIp();
+  body += "\"},\"now\":";
+  body += millis();
+  body += ",\"notifications\":[";
+  body += batch;
+  body += "]}";
+
+  st_log_debug(_NOTIFICATIONS_BATCHER_TAG, "Sending %d notifications to %s", count, url.c_str());
+
+  PooledHttpClient client(url);
+  client.addHeader("Content-Type", "application/json");
+  int code = client.sendRequest("POST", body.c_str());
+
+  if (code >= 200 && code < 300) {
+    _batches++;
+    _notifications += count;
+    st_log_debug(_NOTIFICATIONS_BATCHER_TAG, "Notifications batch send finished with code %d", code);
+    return;
+  }
+  // gateway wasn't reached, batch goes back once, rejected batches are dropped
+  if (code <= 0 && !retried && putBack(batch, count)) {
+    st_log_warning(_NOTIFICATIONS_BATCHER_TAG, "Failed to send %d notifications (code %d), will retry", count, code);
+    return;
+  }
+  dropBatch(count);
+  st_log_error(_NOTIFICATIONS_BATCHER_TAG, "Failed to send notifications batch (code %d), %d notifications dropped", code, count);
+}
+
+void NotificationsBatcherClass::dropBatch(size_t count) {
+  LockGuard guard(_lock);
+  _failedBatches++;
+  _dropped += count;
+}
+
+bool NotificationsBatcherClass::putBack(const String &batch, size_t count) {
+  LockGuard guard(_lock);
+  if (batch.length() + _pending.length() >= NOTIFICATIONS_BATCH_MAX_BYTES * 4) {
+    return false;
+  }
+  if (_count > 0) {
+    _pending = batch + ',' + _pending;
+  } else {
+    _pending = batch;
+  }
+  _count += count;
+  _retry = true;
+  // retry after max latency, it's flushed earlier only if new notifications hit the limits
+  _firstAt = millis();
+  return true;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef NOTIFICATIONS_BATCHER_H
+#define NOTIFICATIONS_BATCHER_H
+
+#include "Features.h"
+
+#if ENABLE_NOTIFICATIONS_BATCHING
+
+#include <Arduino.h>
+
+#include "hooks/dispatcher/HooksDispatcher.h"
+#include "utils/Lock.h"
+
+// Flush when this many notifications are waiting
+#ifndef NOTIFICATIONS_BATCH_MAX_COUNT
+  #define NOTIFICATIONS_BATCH_MAX_COUNT 16
+#endif
+
+// Flush when serialized notifications exceed this size (bytes)
+#ifndef NOTIFICATIONS_BATCH_MAX_BYTES
+  #define NOTIFICATIONS_BATCH_MAX_BYTES 1024
+#endif
+
+// Flush when the oldest notification waits longer than this (ms)
+#ifndef NOTIFICATIONS_BATCH_MAX_LATENCY
+  #define NOTIFICATIONS_BATCH_MAX_LATENCY 2000
+#endif
+
+/*
+  Collects notifications and sends them to gateway as one request:
+  {"device":{...},"now":<millis>,"notifications":[{"message":"...","type":"...","ts":<millis>},...]}
+  ts is device uptime at the moment hook fired, now - at the moment batch was sent.
+  Flush itself is delivered by HooksDispatcher.
+*/
+class NotificationsBatcherClass : public DispatchTarget {
+  public:
+    /*
+      Add notification to current batch
+      @param message resolved notification message
+      @param type notification type name
+    */
+    void add(const String &message, const char * type);
+
+    // Flushes batch if it waits too long, called from SmartThing.loop()
+    void tick();
+
+    void sendRequest(String &value);
+
+    // Batches and notifications delivered to gateway (2xx response)
+    unsigned long batches() { return _batches; }
+    unsigned long notifications() { return _notifications; }
+    // Batches which weren't delivered and notifications dropped with them or on overflow
+    unsigned long failedBatches() { return _failedBatches; }
+    unsigned long dropped() { return _dropped; }
+  private:
+    String _pending;
+    size_t _count = 0;
+    unsigned long _firstAt = 0;
+    bool _flushQueued = false;
+    unsigned long _flushRequestedAt = 0;
+    unsigned long _batches = 0;
+    unsigned long _notifications = 0;
+    unsigned long _failedBatches = 0;
+    unsigned long _dropped = 0;
+    // pending batch starts with notifications which failed to send once
+    bool _retry = false;
+    // guards pending batch
+    Lock _lock;
+    // keeps batches order when several dispatch workers are used
+    Lock _sendLock;
+
+    void requestFlush();
+
+    /*
+      Put notifications which failed to send before pending ones
+      @returns false if they don't fit in pending batch
+    */
+    bool putBack(const String &batch, size_t count);
+
+    // Count batch which wasn't delivered
+    void dropBatch(size_t count);
+};
+
+extern NotificationsBatcherClass NotificationsBatcher;
+
+#endif
+
+#endif
@@ -31,8 +31,8 @@ class ActionHook : public SELECT_HOOK_BASE_CLASS {
     }
 
   protected:
-    String customValuesString() {
-      return _action;
+    void writeCustomValues(ByteWriter &out) {
+      out.writeString(_action);
     }
     
     void populateJsonWithCustomValues(JsonDocument &doc) const {
@@ -8,6 +8,7 @@
 #include "logs/BetterLogger.h"
 #include "hooks/impls/HookConstans.h"
 #include "sensors/Sensor.h"
+#include "utils/ByteStream.h"
 
 #define CHECK_HOOK_DATA_TYPE typename std::enable_if<std::is_same<T, NUMBER_SENSOR_DATA_TYPE>::value || std::is_same<T, TEXT_SENSOR_DATA_TYPE>::value>::type* = nullptr
 
@@ -33,10 +34,17 @@ class Hook {
 
     virtual ~Hook() {};
 
+    // Delete published hook, hooks with deliveries in flight are deleted by HooksDispatcher later
+    virtual void dispose() { delete this; }
+    // For RcuDomain::retire
+    static void disposeRetired(void * hook) { ((Hook<T> *) hook)->dispose(); }
+
     // todo make value const
     virtual bool accept(T &value) = 0;
     virtual void call(T &value) = 0;
     virtual void updateCustom(JsonDocument &doc) {};
+    // Take runtime state (not saved in settings) of hook this one replaces
+    virtual void takeStateFrom(const Hook<T> * hook) {};
 
     void setId(int id) { _id = id; }
     const int getId() const { return _id; }
@@ -46,29 +54,29 @@ class Hook {
     void setCompareType(CompareType type) { _compareType = type; }
     CompareType getCompareType() const { return _compareType; }
     void setTriggerValue(T triggerValue) { _triggerValue = triggerValue; }
+    const T &getTriggerValue() const { return _triggerValue; }
     void setTriggerEnabled(bool enabled) { _triggerEnabled = enabled; }
+    bool isTriggerEnabled() const { return _triggerEnabled; }
     void setReadOnly(bool readOnly) { _readonly = readOnly; }
     bool isReadonly() const { return _readonly; }
-
-    String toString() {
-      String trigger = triggerString();
-      String customValues = customValuesString();
-
-      char * result = (char *) malloc(5 + trigger.length() + 1 + customValues.length() + 1);
-      sprintf(
-        result,
-        "%d%02d%d%d%s;%s",
-        _type,
-        _id,
-        _compareType,
-        _triggerEnabled,
-        trigger.c_str(),
-        customValues.c_str()
-      );
-
-      String tmp = result;
-      free(result);
-      return tmp;
+    HookType getType() const { return _type; }
+    // Name of sensor hook belongs to, set by watcher
+    void setSensorName(const char * name) { _sensorName = name; }
+    const char * getSensorName() const { return _sensorName; }
+
+    /*
+      Writes hook as length-prefixed record:
+      [type 1][varint id][compare 1][flags 1][trigger][threshold][type specific fields]
+    */
+    void serialize(ByteWriter &out) {
+      size_t start = out.beginRecord();
+      out.writeByte(_type);
+      out.writeVarint(_id);
+      out.writeByte(_compareType);
+      out.writeByte(_triggerEnabled ? HOOK_FLAG_TRIGGER_ENABLED : 0);
+      writeTrigger(out);
+      writeCustomValues(out);
+      out.endRecord(start);
     }
 
     JsonDocument toJson() const {
@@ -92,9 +100,11 @@ class Hook {
     CompareType _compareType;
     T _triggerValue;
     bool _readonly;
+    const char * _sensorName = nullptr;
 
-    virtual String triggerString() = 0;
-    virtual String customValuesString() = 0;
+    virtual void writeTrigger(ByteWriter &out) = 0;
+    // readonly hooks are not saved, so they can skip it
+    virtual void writeCustomValues(ByteWriter &out) {};
     virtual void addTypeSpecificValues(JsonDocument &doc) const {};
     virtual void populateJsonWithCustomValues(JsonDocument &doc) const {};
 };
@@ -130,6 +140,15 @@ class NumberSensorHook: public Hook<NUMBER_SENSOR_DATA_TYPE> {
     void setThreshold(NUMBER_SENSOR_DATA_TYPE threshold) {
       _threshold = threshold;
     }
+    NUMBER_SENSOR_DATA_TYPE getThreshold() const {
+      return _threshold;
+    }
+    void setPreviousValue(NUMBER_SENSOR_DATA_TYPE value) {
+      _previousValue = value;
+    }
+    void takeStateFrom(const Hook<NUMBER_SENSOR_DATA_TYPE> * hook) {
+      _previousValue = ((const NumberSensorHook *) hook)->_previousValue;
+    }
   private:
     NUMBER_SENSOR_DATA_TYPE _threshold;
     NUMBER_SENSOR_DATA_TYPE _previousValue;
@@ -139,12 +158,9 @@ class NumberSensorHook: public Hook<NUMBER_SENSOR_DATA_TYPE> {
       doc[_thresholdHookField] = _threshold;
     }
 
-    String triggerString() {
-      int size = snprintf(NULL, 0, "%ld:%ld", _triggerValue, _threshold);
-      char buff[size + 1];
-      sprintf(buff, "%ld_%ld", _triggerValue, _threshold);
-      String tmp = buff;
-      return tmp;
+    void writeTrigger(ByteWriter &out) {
+      out.writeSigned(_triggerValue);
+      out.writeSigned(_threshold);
     }
 };
 #endif
@@ -161,16 +177,14 @@ class TextSensorHook: public Hook<TEXT_SENSOR_DATA_TYPE> {
         case CompareType::EQ:
           return _triggerValue.equals(value);
         case CompareType::NEQ:
-          return _triggerValue.equals(value);
+          return !_triggerValue.equals(value);
         default:
           return false;
       }
     }
   protected:
-    TEXT_SENSOR_DATA_TYPE triggerString() {
-      String copy = _triggerValue;
-      copy.replace(";", "|;");
-      return _triggerValue;
+    void writeTrigger(ByteWriter &out) {
+      out.writeString(_triggerValue);
     }
 };
 #endif
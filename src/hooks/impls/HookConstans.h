@@ -21,6 +21,9 @@ const char * const COMPARE_NEQ = "neq";
 const char * const COMPARE_GTE = "gte";
 const char * const COMPARE_LTE = "lte";
 
+// Hook record flags
+#define HOOK_FLAG_TRIGGER_ENABLED 0x01
+
 enum HookType {
   UNKNOWN_HOOK,
   LAMBDA_HOOK,
@@ -1,18 +1,16 @@
 #ifndef HTTP_HOOK_H
 #define HTTP_HOOK_H
 
-#ifdef ARDUINO_ARCH_ESP32
-#include <HTTPClient.h>
-#endif
-#ifdef ARDUINO_ARCH_ESP8266
-#include <ESP8266HTTPClient.h>
-#include <WiFiClient.h>
-#endif
 #include <type_traits>
 
 #include "hooks/impls/Hook.h"
+#include "hooks/dispatcher/HooksDispatcher.h"
+#include "net/http/HttpConnectionPool.h"
 #include "logs/BetterLogger.h"
-#include "utils/StringUtils.h"
+#if ENABLE_EVENTS
+  #include "net/events/EventsStream.h"
+#endif
+#include "utils/ValueTemplate.h"
 
 const char * const _HTTP_HOOK_TAG = "http_hook";
 const char * const _urlHookField = "url";
@@ -76,71 +74,79 @@ inline RequestMethod requestMethodFromStr(const char * method) {
 }
 
 template<typename T, CHECK_HOOK_DATA_TYPE>
-class HttpHook : public SELECT_HOOK_BASE_CLASS {
+class HttpHook : public SELECT_HOOK_BASE_CLASS, public DispatchTarget {
   public:
     HttpHook(const char *url, RequestMethod method, const char * payload)
-        : SELECT_HOOK_BASE_CLASS(HTTP_HOOK), _url(url), _method(method), _payload(payload) {
-      _url.trim();
+        : SELECT_HOOK_BASE_CLASS(HTTP_HOOK), _method(method), _payload(payload) {
+      String trimmed = url;
+      trimmed.trim();
+      _url.compile(trimmed);
       if (method == UNKOWN_METHOD) {
         method = GET_METHOD;
       } 
     };
     virtual ~HttpHook() {};
 
+    void dispose() {
+      if (HooksDispatcher.release(this)) {
+        delete this;
+      }
+    }
+
     void call(T &value) {
-      _currentValue = value;
       if (SmartThing.wifiConnected()) {
-        createRequestTask();
+        HooksDispatcher.dispatch(this, String(value));
       } else {
         st_log_error(_HTTP_HOOK_TAG, "WiFi not connected!");
       }
     };
 
-    void setPayload(const char *payload) { _payload = payload; }
+    void setPayload(const char *payload) { _payload.compile(payload); }
     void setMethod(const char *method) { _method = method; }
 
-    #ifdef ARDUINO_ARCH_ESP32
-    TaskHandle_t _requestTask = NULL;  // not safe todo setter?
-    #endif
-    bool _sending = false;
-    
-  protected:
-    String customValuesString() {
-      String tmp;
-      String res;
-
-      for (int i = 0; i < 3; i++) {
-        switch(i) {
-          case 0:
-            tmp = _url;
-            break;
-          case 1:
-            tmp = String(_method);
-            break;
-          case 2:
-            tmp = _payload;
-            break;
-        }
-        tmp.replace(";", "|;");
-        res += tmp;
-        res += ';';
+    void sendRequest(String &valueStr) {
+      String urlResolved = _url.render(valueStr);
+      String payloadResolved = _payload.render(valueStr);
+
+      if (!urlResolved.startsWith("http")) {
+        urlResolved = "http://" + urlResolved;
+      }
+
+      st_log_debug(_HTTP_HOOK_TAG, "Resolved url and payload: %s :: %s", urlResolved.c_str(), payloadResolved.c_str());
+      st_log_debug(_HTTP_HOOK_TAG, "Sending request [%s] %s :: %s", requestMethodToStr(_method), urlResolved.c_str(), payloadResolved.c_str());
+
+      PooledHttpClient client(urlResolved);
+      if (!payloadResolved.isEmpty()) {
+        client.addHeader("Content-Type", "application/json");
       }
-      
-      return res;
+      _lastResponseCode = client.sendRequest(requestMethodToStr(_method), payloadResolved.c_str());
+
+      st_log_info(_HTTP_HOOK_TAG, "Request %s finished with code %d", urlResolved.c_str(), _lastResponseCode);
+      #if ENABLE_EVENTS
+        EventsStream.hookResult(this->getSensorName(), this->getId(), hookTypeToStr(this->getType()), _lastResponseCode);
+      #endif
+    }
+
+  protected:
+    void writeCustomValues(ByteWriter &out) {
+      out.writeString(_url.source());
+      out.writeByte(_method);
+      out.writeString(_payload.source());
     }
 
     void populateJsonWithCustomValues(JsonDocument &doc) const {
       doc["lastResponseCode"] = _lastResponseCode;
-      doc[_urlHookField] = _url;
+      doc[_urlHookField] = _url.source();
       doc[_methodHookField] = _method;
-      doc[_payloadHookField] = _payload;
+      doc[_payloadHookField] = _payload.source();
     };
 
     void updateCustom(JsonDocument &doc) {
       if (doc[_urlHookField].is<const char*>()) {
-        _url = doc[_urlHookField].as<String>();
-        _url.trim();
-        st_log_debug(_HTTP_HOOK_TAG, "Hook's url was updated to %s", _url.c_str());
+        String url = doc[_urlHookField].as<String>();
+        url.trim();
+        _url.compile(url);
+        st_log_debug(_HTTP_HOOK_TAG, "Hook's url was updated to %s", _url.source().c_str());
       }
 
       if (doc[_methodHookField].is<JsonVariant>()) {
@@ -154,68 +160,14 @@ class HttpHook : public SELECT_HOOK_BASE_CLASS {
       }
 
       if (doc[_payloadHookField].is<const char*>()) {
-        _payload = doc[_payloadHookField].as<String>();
-        st_log_debug(_HTTP_HOOK_TAG, "Hook's payload was updated to %s", _payload.c_str());
+        _payload.compile(doc[_payloadHookField].as<String>());
+        st_log_debug(_HTTP_HOOK_TAG, "Hook's payload was updated to %s", _payload.source().c_str());
       }
     };
  private:
-  String _url;
+  ValueTemplate _url;
   RequestMethod _method;
-  String _payload;
+  ValueTemplate _payload;
   int16_t _lastResponseCode = 0;
-  T _currentValue; // todo try to remove
-
-  void createRequestTask() {
-    if (_sending) {
-      st_log_debug(_HTTP_HOOK_TAG, "Request task already exist! Skipping");
-      return;
-    }
-    #ifdef ARDUINO_ARCH_ESP32
-    xTaskCreate(
-      [](void *o) {
-        HttpHook *hook = static_cast<HttpHook *>(o);
-        hook->_sending = true;
-        hook->sendRequest();
-        hook->_sending = false;
-        vTaskDelete(hook->_requestTask);
-      },
-      _url.c_str(), 10000, this, 1, &_requestTask);
-    #endif
-    #ifdef ARDUINO_ARCH_ESP8266
-    _sending = true;
-    sendRequest(); // todo make async
-    _sending = false;
-    #endif
-  }
-
-  void sendRequest() {
-    String valueStr = String(_currentValue);
-    String urlResolved = replaceValues(_url.c_str(), valueStr);
-    String payloadResolved = replaceValues(_payload.c_str(), valueStr);
-
-    if (!urlResolved.startsWith("http")) {
-      urlResolved = "http://" + urlResolved;
-    }
-
-    st_log_debug(_HTTP_HOOK_TAG, "Resolved url and payload: %s :: %s", urlResolved.c_str(), payloadResolved.c_str());
-    st_log_debug(_HTTP_HOOK_TAG, "Sending request [%s] %s :: %s", requestMethodToStr(_method), urlResolved.c_str(), payloadResolved.c_str());
-
-    HTTPClient client;
-    client.setTimeout(2000);
-    #ifdef ARDUINO_ARCH_ESP32
-    client.begin(urlResolved);
-    #endif
-    #ifdef ARDUINO_ARCH_ESP8266
-    WiFiClient wifiClient; // todo global var?
-    client.begin(wifiClient, urlResolved);
-    #endif
-    if (!payloadResolved.isEmpty()) {
-      client.addHeader("Content-Type", "application/json");
-    }
-    _lastResponseCode = client.sendRequest(requestMethodToStr(_method), payloadResolved.c_str());
-    client.end();
-
-    st_log_info(_HTTP_HOOK_TAG, "Request %s finished with code %d", urlResolved.c_str(), _lastResponseCode);
-  }
 };
 #endif
\ No newline at end of file
@@ -6,19 +6,18 @@
 // todo this hook requires rework
 // if config not enabled - use internal
 
-#ifdef ARDUINO_ARCH_ESP32
-#include <HTTPClient.h>
-#endif
-#ifdef ARDUINO_ARCH_ESP8266
-#include <ESP8266HTTPClient.h>
-#include <WiFiClient.h>
-#endif
 #include <type_traits>
 
 #include "SmartThing.h"
 #include "hooks/impls/Hook.h"
+#include "hooks/dispatcher/HooksDispatcher.h"
+#include "hooks/dispatcher/NotificationsBatcher.h"
+#include "net/http/HttpConnectionPool.h"
 #include "config/ConfigManager.h"
-#include "utils/StringUtils.h"
+#if ENABLE_EVENTS
+  #include "net/events/EventsStream.h"
+#endif
+#include "utils/ValueTemplate.h"
 
 const char * const _NOTIFICATION_HOOK_TAG = "notification_hook";
 const char * const _messageHookField = "message";
@@ -74,7 +73,7 @@ inline NotificationType notificationTypeFromStr(const char * type, NotificationT
 
 // todo extend http hook
 template<typename T, CHECK_HOOK_DATA_TYPE>
-class NotificationHook : public SELECT_HOOK_BASE_CLASS {
+class NotificationHook : public SELECT_HOOK_BASE_CLASS, public DispatchTarget {
   public:
     #if ENABLE_CONFIG
     NotificationHook(NotificationType notificationType, const char * message)
@@ -85,20 +84,30 @@ class NotificationHook : public SELECT_HOOK_BASE_CLASS {
     #endif
     virtual ~NotificationHook() {};
 
+    void dispose() {
+      if (HooksDispatcher.release(this)) {
+        delete this;
+      }
+    }
+
     void call(T &value) {
-      _currentValue = value;
       if (WiFi.isConnected()) {
-        createRequestTask();
+        #if ENABLE_NOTIFICATIONS_BATCHING
+          String valueStr = String(value);
+          NotificationsBatcher.add(_message.render(valueStr), notificationTypeToStr(_notificationType));
+        #else
+          HooksDispatcher.dispatch(this, String(value));
+        #endif
       } else {
         st_log_error(_NOTIFICATION_HOOK_TAG, "WiFi not connected!");
       }
     }
 
     String getMessage() {
-      return _message;
+      return _message.source();
     }
     void setMessage(const char * message) {
-      _message = message;
+      _message.compile(message);
     }
     void setNotificationType(NotificationType type) {
       _notificationType = type;
@@ -106,92 +115,8 @@ class NotificationHook : public SELECT_HOOK_BASE_CLASS {
     NotificationType getNoticationType() {
       return _notificationType;
     }
-    #ifdef ARDUINO_ARCH_ESP32
-    TaskHandle_t _requestTask = NULL;
-    #endif
-    bool _sending = false;
-
-  protected:
-    #if ENABLE_CONFIG
-      String customValuesString() {
-        String tmp = _message;
-        tmp.replace(";", "|;");
-        char buff[2 + tmp.length()];
-        sprintf(buff, "%d%s", _notificationType, tmp.c_str());
-        tmp = buff;
-        return tmp;
-      }
-    #else
-      String customValuesString() {
-        String tmp = _message;
-        String tmp1 = _gateway;
-        tmp.replace(";", "|;");
-        tmp1.replace(";", "|;");
-        char buff[tmp.length() + tmp1.length() + 3];
-        sprintf(buff, "%d%s;%s", _notificationType, tmp.c_str(), tmp1.c_str());
-        tmp = buff;
-        return tmp;
-      }
-    #endif
-
-    void populateJsonWithCustomValues(JsonDocument &doc) const {
-      doc[_messageHookField] = _message.c_str();
-      doc[_nftHookField] = _notificationType;
-      #if !(ENABLE_CONFIG)
-        doc[_gatewayHookField] = _gateway;
-      #endif
-    }
-
-    void updateCustom(JsonDocument &doc) {
-      if (doc[_messageHookField].is<const char*>()) {
-        _message = doc[_messageHookField].as<const char*>();
-      }
-      if (doc[_nftHookField].is<JsonVariant>()) {
-        int type = doc[_nftHookField].as<int>();
-        if (type < NOTIFICATION_INFO || type > NOTIFICATION_ERROR) {
-          st_log_error(_NOTIFICATION_HOOK_TAG, "Unknown notification type: %d", type);
-        } else {
-          _notificationType = static_cast<NotificationType>(type);
-        }
-      }
-      #if !(ENABLE_CONFIG)
-        if (doc[_gatewayHookField].is<const char*>()) {
-          _gateway = doc[_gatewayHookField].as<const char*>();
-        }
-      #endif
-    }
-    
-  private:
-    String _message; // todo char array
-    NotificationType _notificationType;
-    T _currentValue;
-    #if !(ENABLE_CONFIG)
-    String _gateway; // todo char array
-    #endif
 
-    void createRequestTask() {
-      if (_sending) {
-        return;
-      }
-      #ifdef ARDUINO_ARCH_ESP32
-      xTaskCreate(
-        [](void *o) {
-          NotificationHook *hook = static_cast<NotificationHook *>(o);
-          hook->_sending = true;
-          hook->sendRequest();
-          hook->_sending = false;
-          vTaskDelete(hook->_requestTask);
-        },
-        "notification", 10000, this, 1, &_requestTask);
-      #endif
-      #ifdef ARDUINO_ARCH_ESP8266
-      _sending = true;
-      sendRequest(); // todo async
-      _sending = false;
-      #endif
-    }
-
-    void sendRequest() {
+    void sendRequest(String &valueStr) {
       #if ENABLE_CONFIG
         String _gateway = ConfigManager.get(GATEWAY_CONFIG);
       #endif  
@@ -200,8 +125,7 @@ class NotificationHook : public SELECT_HOOK_BASE_CLASS {
         return;
       }
 
-      String valueStr = String(_currentValue);
-      String messageResolved = replaceValues(_message.c_str(), valueStr);
+      String messageResolved = _message.render(valueStr);
       const char * type = notificationTypeToStr(_notificationType);
 
       size_t size = _bodyTemplateLength +
@@ -227,21 +151,57 @@ class NotificationHook : public SELECT_HOOK_BASE_CLASS {
 
       st_log_debug(_NOTIFICATION_HOOK_TAG, "Sending notification to [%s]:%s", url.c_str(), payload);
 
-      HTTPClient client;
-      client.setTimeout(2000);
-      #ifdef ARDUINO_ARCH_ESP32
-        client.begin(url);
-      #endif
-      #ifdef ARDUINO_ARCH_ESP8266
-        WiFiClient wifiClient; // todo global var?
-        client.begin(wifiClient, url);
-      #endif
-
+      PooledHttpClient client(url);
       client.addHeader("Content-Type", "application/json");
       int code = client.sendRequest("POST", payload);
-      client.end();
 
       st_log_debug(_NOTIFICATION_HOOK_TAG, "Notification send request finished with code %d", code);
+      #if ENABLE_EVENTS
+        EventsStream.hookResult(this->getSensorName(), this->getId(), hookTypeToStr(this->getType()), code);
+      #endif
     }
+
+  protected:
+    void writeCustomValues(ByteWriter &out) {
+      out.writeByte(_notificationType);
+      out.writeString(_message.source());
+      #if !(ENABLE_CONFIG)
+        out.writeString(_gateway);
+      #endif
+    }
+
+    void populateJsonWithCustomValues(JsonDocument &doc) const {
+      doc[_messageHookField] = _message.source().c_str();
+      doc[_nftHookField] = _notificationType;
+      #if !(ENABLE_CONFIG)
+        doc[_gatewayHookField] = _gateway;
+      #endif
+    }
+
+    void updateCustom(JsonDocument &doc) {
+      if (doc[_messageHookField].is<const char*>()) {
+        _message.compile(doc[_messageHookField].as<const char*>());
+      }
+      if (doc[_nftHookField].is<JsonVariant>()) {
+        int type = doc[_nftHookField].as<int>();
+        if (type < NOTIFICATION_INFO || type > NOTIFICATION_ERROR) {
+          st_log_error(_NOTIFICATION_HOOK_TAG, "Unknown notification type: %d", type);
+        } else {
+          _notificationType = static_cast<NotificationType>(type);
+        }
+      }
+      #if !(ENABLE_CONFIG)
+        if (doc[_gatewayHookField].is<const char*>()) {
+          _gateway = doc[_gatewayHookField].as<const char*>();
+        }
+      #endif
+    }
+    
+  private:
+    ValueTemplate _message;
+    NotificationType _notificationType;
+    #if !(ENABLE_CONFIG)
+    String _gateway; // todo char array
+    #endif
 };
 #endif
\ No newline at end of file
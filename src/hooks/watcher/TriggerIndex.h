@@ -0,0 +1,259 @@
+#ifndef TRIGGER_INDEX_H
+#define TRIGGER_INDEX_H
+
+#include "Features.h"
+
+#if ENABLE_HOOKS
+
+#include <algorithm>
+#include <vector>
+
+#include "hooks/impls/Hook.h"
+#include "utils/InternTable.h"
+
+/*
+  Finds hooks of one watcher which trigger condition can match new value.
+  Default one has no index, all hooks are checked with accept().
+*/
+template <typename T>
+class TriggerIndex {
+  public:
+    void rebuild(const std::vector<Hook<T>*> &hooks, const T &lastValue) {}
+
+    /*
+      Put positions (in watcher's hooks list) of hooks to check in ascending order
+      @returns false if all hooks should be checked
+    */
+    bool match(const T &value, std::vector<uint16_t> &positions) {
+      return false;
+    }
+};
+
+#if ENABLE_NUMBER_SENSORS
+/*
+  Hooks with enabled trigger and without threshold are kept in arrays sorted by trigger value,
+  one per compare type. New value finds them with binary search:
+  EQ - equal range, GTE - triggers <= value, LTE - triggers >= value.
+  Hooks with threshold (they depend on previous value), NEQ and disabled trigger are always checked.
+*/
+template <>
+class TriggerIndex<NUMBER_SENSOR_DATA_TYPE> {
+  public:
+    void rebuild(const std::vector<Hook<NUMBER_SENSOR_DATA_TYPE>*> &hooks, NUMBER_SENSOR_DATA_TYPE lastValue) {
+      std::vector<const Hook<NUMBER_SENSOR_DATA_TYPE>*> wasIndexed;
+      std::vector<int> wasIndexedIds;
+      wasIndexed.swap(_indexed);
+      wasIndexedIds.swap(_indexedIds);
+
+      _always.clear();
+      for (uint8_t i = 0; i < INDEXED_COMPARE_TYPES; i++) {
+        _entries[i].clear();
+      }
+
+      for (uint16_t position = 0; position < hooks.size(); position++) {
+        NumberSensorHook * hook = (NumberSensorHook *) hooks[position];
+        int8_t index = entriesIndex(hook);
+        if (index < 0) {
+          // accept() of indexed hook wasn't called, so it missed previous value updates
+          if (std::binary_search(wasIndexed.begin(), wasIndexed.end(), hook) ||
+              (hook->getId() >= 0 && std::binary_search(wasIndexedIds.begin(), wasIndexedIds.end(), hook->getId()))) {
+            hook->setPreviousValue(lastValue);
+          }
+          _always.push_back(position);
+          continue;
+        }
+        _entries[index].push_back({hook->getTriggerValue(), position});
+        _indexed.push_back(hook);
+        if (hook->getId() >= 0) {
+          _indexedIds.push_back(hook->getId());
+        }
+      }
+
+      for (uint8_t i = 0; i < INDEXED_COMPARE_TYPES; i++) {
+        std::sort(_entries[i].begin(), _entries[i].end(), [](const Entry &a, const Entry &b) {
+          return a.trigger < b.trigger || (a.trigger == b.trigger && a.position < b.position);
+        });
+        _entries[i].shrink_to_fit();
+      }
+      std::sort(_indexed.begin(), _indexed.end());
+      std::sort(_indexedIds.begin(), _indexedIds.end());
+      _always.shrink_to_fit();
+    }
+
+    bool match(NUMBER_SENSOR_DATA_TYPE value, std::vector<uint16_t> &positions) {
+      positions.assign(_always.begin(), _always.end());
+      size_t sorted = positions.size();
+
+      std::vector<Entry> &eq = _entries[EQ_ENTRIES];
+      auto range = std::equal_range(eq.begin(), eq.end(), value, TriggerCompare());
+      addPositions(range.first, range.second, positions, sorted);
+
+      std::vector<Entry> &gte = _entries[GTE_ENTRIES];
+      addPositions(gte.begin(), std::upper_bound(gte.begin(), gte.end(), value, TriggerCompare()), positions, sorted);
+
+      std::vector<Entry> &lte = _entries[LTE_ENTRIES];
+      addPositions(std::lower_bound(lte.begin(), lte.end(), value, TriggerCompare()), lte.end(), positions, sorted);
+
+      if (sorted != positions.size()) {
+        std::sort(positions.begin(), positions.end());
+      }
+      return true;
+    }
+
+  private:
+    struct Entry {
+      NUMBER_SENSOR_DATA_TYPE trigger;
+      uint16_t position;
+    };
+
+    struct TriggerCompare {
+      bool operator()(const Entry &entry, NUMBER_SENSOR_DATA_TYPE value) const {
+        return entry.trigger < value;
+      }
+      bool operator()(NUMBER_SENSOR_DATA_TYPE value, const Entry &entry) const {
+        return value < entry.trigger;
+      }
+    };
+
+    enum EntriesIndex {
+      EQ_ENTRIES,
+      GTE_ENTRIES,
+      LTE_ENTRIES,
+      INDEXED_COMPARE_TYPES
+    };
+
+    std::vector<Entry> _entries[INDEXED_COMPARE_TYPES];
+    // positions of hooks checked on every value
+    std::vector<uint16_t> _always;
+    // sorted, to find hooks leaving the index on rebuild
+    std::vector<const Hook<NUMBER_SENSOR_DATA_TYPE>*> _indexed;
+    // updated hook is a new object with the same id
+    std::vector<int> _indexedIds;
+
+    static int8_t entriesIndex(const NumberSensorHook * hook) {
+      if (!hook->isTriggerEnabled() || hook->getThreshold() != 0) {
+        return -1;
+      }
+      switch (hook->getCompareType()) {
+        case CompareType::EQ:
+          return EQ_ENTRIES;
+        case CompareType::GTE:
+          return GTE_ENTRIES;
+        case CompareType::LTE:
+          return LTE_ENTRIES;
+        default:
+          return -1;
+      }
+    }
+
+    // @param sorted length of positions prefix which is still in ascending order
+    template <typename It>
+    static void addPositions(It from, It to, std::vector<uint16_t> &positions, size_t &sorted) {
+      for (; from != to; ++from) {
+        if (sorted == positions.size() && (sorted == 0 || positions.back() < from->position)) {
+          sorted++;
+        }
+        positions.push_back(from->position);
+      }
+    }
+};
+#endif
+
+#if ENABLE_TEXT_SENSORS
+/*
+  EQ and NEQ hooks with enabled trigger are kept in arrays sorted by interned trigger id,
+  so hooks for new value are found with binary search by value's id:
+  EQ - hooks with value's id, NEQ - all except them.
+  Hooks with trigger which can't be interned and disabled trigger are always checked.
+*/
+template <>
+class TriggerIndex<TEXT_SENSOR_DATA_TYPE> {
+  public:
+    void rebuild(const std::vector<Hook<TEXT_SENSOR_DATA_TYPE>*> &hooks, const TEXT_SENSOR_DATA_TYPE &lastValue) {
+      _always.clear();
+      _eq.clear();
+      _neq.clear();
+
+      for (uint16_t position = 0; position < hooks.size(); position++) {
+        const Hook<TEXT_SENSOR_DATA_TYPE> * hook = hooks[position];
+        InternId trigger = hook->isTriggerEnabled() ? InternTable.intern(hook->getTriggerValue()) : INTERN_NONE;
+        if (trigger == INTERN_NONE) {
+          _always.push_back(position);
+          continue;
+        }
+        switch (hook->getCompareType()) {
+          case CompareType::EQ:
+            _eq.push_back({trigger, position});
+            break;
+          case CompareType::NEQ:
+            _neq.push_back({trigger, position});
+            break;
+          default:
+            _always.push_back(position);
+        }
+      }
+
+      sortEntries(_eq);
+      sortEntries(_neq);
+      _always.shrink_to_fit();
+    }
+
+    bool match(const TEXT_SENSOR_DATA_TYPE &value, std::vector<uint16_t> &positions) {
+      // all indexed triggers are in the table, so value which isn't there matches none of them
+      InternId id = InternTable.find(value);
+
+      positions.assign(_always.begin(), _always.end());
+      if (id != INTERN_NONE) {
+        auto range = std::equal_range(_eq.begin(), _eq.end(), id, TriggerCompare());
+        addPositions(range.first, range.second, positions);
+      }
+
+      auto skip = std::equal_range(_neq.begin(), _neq.end(), id, TriggerCompare());
+      addPositions(_neq.begin(), skip.first, positions);
+      addPositions(skip.second, _neq.end(), positions);
+
+      if (positions.size() != _always.size()) {
+        std::sort(positions.begin(), positions.end());
+      }
+      return true;
+    }
+
+  private:
+    struct Entry {
+      InternId trigger;
+      uint16_t position;
+    };
+
+    struct TriggerCompare {
+      bool operator()(const Entry &entry, InternId id) const {
+        return entry.trigger < id;
+      }
+      bool operator()(InternId id, const Entry &entry) const {
+        return id < entry.trigger;
+      }
+    };
+
+    std::vector<Entry> _eq;
+    std::vector<Entry> _neq;
+    // positions of hooks checked on every value
+    std::vector<uint16_t> _always;
+
+    static void sortEntries(std::vector<Entry> &entries) {
+      std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.trigger < b.trigger || (a.trigger == b.trigger && a.position < b.position);
+      });
+      entries.shrink_to_fit();
+    }
+
+    template <typename It>
+    static void addPositions(It from, It to, std::vector<uint16_t> &positions) {
+      for (; from != to; ++from) {
+        positions.push_back(from->position);
+      }
+    }
+};
+#endif
+
+#endif
+
+#endif
@@ -5,6 +5,7 @@
   #if ENABLE_NUMBER_SENSORS
     template<>
     bool Watcher<NUMBER_SENSOR_DATA_TYPE>::check() {
+      LockGuard guard(_checkLock);
       if (_sensor != nullptr) {
         NUMBER_SENSOR_DATA_TYPE newValue = _sensor->provideValue();
         if (_oldValue == -1) {
@@ -29,21 +30,38 @@
   #if ENABLE_TEXT_SENSORS
     template<>
     bool Watcher<TEXT_SENSOR_DATA_TYPE>::check() {
+      LockGuard guard(_checkLock);
       if (_sensor == nullptr) {
         return false;
       }
-      TEXT_SENSOR_DATA_TYPE newValue = _sensor->provideValue();
+      // unchanged interned value costs one integer compare, no string copy
+      InternId newValueId = _sensor->provideValueId();
+      if (newValueId != INTERN_NONE && newValueId == _oldValueId) {
+        return false;
+      }
+
+      // copied into reused string, so no allocation while value fits its capacity
+      if (newValueId != INTERN_NONE) {
+        _newValue = InternTable.value(newValueId);
+      } else {
+        _sensor->readValue([this](const TEXT_SENSOR_DATA_TYPE &value) {
+          _newValue = value;
+        });
+      }
       if (_oldValue.isEmpty()) {
-        _oldValue = newValue;
+        _oldValue = _newValue;
+        _oldValueId = newValueId;
         return false;
       }
 
-      if (!newValue.equals(_oldValue)) {
-        callHooks(newValue);
+      if (!_newValue.equals(_oldValue)) {
+        callHooks(_newValue);
 
-        _oldValue = newValue;
+        _oldValue = _newValue;
+        _oldValueId = newValueId;
         return true;
       }
+      _oldValueId = newValueId;
       return false;
     }
     template<>
@@ -6,18 +6,36 @@
 #if ENABLE_HOOKS
 
 #include <ArduinoJson.h>
+#include <algorithm>
 #include <functional>
-#include <list>
+#include <vector>
 
 #include "hooks/impls/Hook.h"
+#include "hooks/watcher/TriggerIndex.h"
 #include "sensors/Sensor.h"
 #include "logs/BetterLogger.h"
+#include "utils/IdAllocator.h"
+#include "utils/NameIndex.h"
+#include "utils/Rcu.h"
+
+#if ENABLE_EVENTS
+  #include "net/events/EventsStream.h"
+#endif
 
 const char * const _WATCHER_TAG = "watcher";
 
+// Max hook id for one sensor, ids bitmap takes up to HOOKS_MAX_ID / 8 bytes
+#ifndef HOOKS_MAX_ID
+  #define HOOKS_MAX_ID 0xFFFF
+#endif
+
 /*
     Класс наблюдатель за сенсорами
     T - тип данных, которые хранит в себе сенсор
+
+    Hooks list is published as immutable snapshot: check() reads it inside
+    RCU read section, add/remove/replace (writer lock is held by HooksManager)
+    publish a new list and retire the old one.
 */
 
 template <typename T>
@@ -25,47 +43,62 @@ class Watcher {
  public:
   Watcher(const Sensor<T> *sensor)
       : _sensor(sensor),
-        _hookIdSequence(0) {
+        _hooks(new HooksSnapshot()),
+        _ids(HOOKS_MAX_ID),
+        _nextCheck(millis()),
+        _phased(false) {
     setInitialValue();
   };
-  ~Watcher() {};
+  // Hooks are removed before watcher, so only empty list is left
+  ~Watcher() {
+    delete _hooks.load();
+  };
 
+  // Must be called in read section
   bool check();
 
   void callHooks(T &value) {
-    if (_hooks.size() == 0) {
-      return;
+    _lastCalled = 0;
+    const HooksSnapshot * snapshot = _hooks.load();
+    const std::vector<Hook<T>*> &hooks = snapshot->hooks;
+    if (snapshot->version != _indexedVersion) {
+      _index.rebuild(hooks, _oldValue);
+      _indexedVersion = snapshot->version;
     }
-    for (auto it = _hooks.begin(); it != _hooks.end(); ++it) {
-      Hook<T> *current = *it;
-      if (current != nullptr && current->accept(value)) {
-        st_log_debug(
-          _WATCHER_TAG,
-          "Calling hook [id=%d] for sensor %s",
-          current->getId(),
-          _sensor->name()
-        );
-        current->call(value);
+    if (!_index.match(value, _candidates)) {
+      for (Hook<T> * current : hooks) {
+        callHook(current, value);
       }
+      return;
+    }
+    // positions are ascending, so hooks are called in the order they were added
+    for (uint16_t position : _candidates) {
+      callHook(hooks[position], value);
     }
   }
- 
+
+  // Writer only, checks ids bitmap before searching
   Hook<T> *getHookById(int id) {
-    if (id < 0) {
+    if (id < 0 || !_ids.isUsed(id)) {
       return nullptr;
     }
+    return findHook(id);
+  }
 
-    auto it = std::find_if(_hooks.begin(), _hooks.end(), [id](const Hook<T> * hook) {
+  // Must be called in read section or by writer
+  Hook<T> *findHook(int id) const {
+    const std::vector<Hook<T>*> &hooks = _hooks.load()->hooks;
+    auto it = std::find_if(hooks.begin(), hooks.end(), [id](const Hook<T> * hook) {
       return hook->getId() == id;
     });
 
-    if (it == _hooks.end()) {
+    if (it == hooks.end()) {
       return nullptr;
     }
     return *it;
   }
-   
-  bool add(Hook<T> *hook) {
+
+  bool add(Hook<T> *hook, RcuDomain &rcu) {
     if (hook == nullptr) {
       st_log_error(_WATCHER_TAG, "Hook is missing!");
       return false;
@@ -74,71 +107,89 @@ class Watcher {
     if (hook->isReadonly()) {
       hook->setId(-1);
     } else if (hook->getId() < 0) {
-      int id = getNextHookId();
+      int id = _ids.allocate();
       if (id < 0) {
         st_log_error(_WATCHER_TAG, "Failed to generate new id for hook");
         return false;
       }
       hook->setId(id);
-    } else if (getHookById(hook->getId()) != nullptr) {
-      st_log_error(_WATCHER_TAG, "Hook with id=%d already exists!", hook->getId());
+    } else if (!_ids.reserve(hook->getId())) {
+      st_log_error(_WATCHER_TAG, "Hook with id=%d already exists or id is out of range!", hook->getId());
       return false;
     }
 
-    _hooks.push_back(hook);
+    hook->setSensorName(_sensor->name());
+    HooksSnapshot * next = copyHooks();
+    next->hooks.push_back(hook);
+    publish(next, rcu);
     return true;
   }
-   
-  bool removeHook(int id) {
+
+  bool removeHook(int id, RcuDomain &rcu) {
     if (id < 0) {
       st_log_error(_WATCHER_TAG, "Failed to remove hook - id negative!");
       return false;
     }
 
-    auto it = std::find_if(_hooks.begin(), _hooks.end(), [id](const Hook<T> * hook) {
-      return hook->getId() == id;
-    });
-    if (it == _hooks.end()) {
+    Hook<T> *hook = findHook(id);
+    if (hook == nullptr) {
       st_log_error(_WATCHER_TAG,
                   "Failed to remove hook - can't find hook with id %d",
                   id);
       return false;
     }
-
-    Hook<T> *hook = *it;
     if (hook->isReadonly()) {
       st_log_error(_WATCHER_TAG, "This hook is readonly!");
       return false;
     }
 
-    delete hook;
-    _hooks.erase(it);
+    HooksSnapshot * next = copyHooks();
+    next->hooks.erase(std::find(next->hooks.begin(), next->hooks.end(), hook));
+    publish(next, rcu);
+    // readers may still be calling it
+    rcu.retire(hook, &Hook<T>::disposeRetired);
+    _ids.release(id);
     st_log_warning(_WATCHER_TAG, "Hook %d removed", id);
     return true;
   }
- 
-  String toString() {
-    if (_hooks.size() == 0) {
-      return "";
+
+  // Put replacement (hook with the same id) in place of hook, writer only
+  bool replaceHook(Hook<T> *hook, Hook<T> *replacement, RcuDomain &rcu) {
+    HooksSnapshot * next = copyHooks();
+    auto it = std::find(next->hooks.begin(), next->hooks.end(), hook);
+    if (it == next->hooks.end() || replacement == nullptr || replacement->getId() != hook->getId()) {
+      delete next;
+      return false;
     }
+    replacement->setSensorName(_sensor->name());
+    *it = replacement;
+    publish(next, rcu);
+    rcu.retire(hook, &Hook<T>::disposeRetired);
+    return true;
+  }
 
-    String result = _sensor->name();
+  // Writes [sensor name][varint hooks count][hook records], readonly hooks are skipped
+  void serialize(ByteWriter &out) {
+    const std::vector<Hook<T>*> &hooks = _hooks.load()->hooks;
+    uint32_t count = std::count_if(hooks.begin(), hooks.end(), [](const Hook<T> * hook) {
+      return !hook->isReadonly();
+    });
+    if (count == 0) {
+      return;
+    }
 
-    for (auto it = _hooks.begin(); it != _hooks.end(); ++it) {
-      if ((*it)->isReadonly()) {
-        continue;
+    out.writeString(_sensor->name());
+    out.writeVarint(count);
+    for (auto it = hooks.begin(); it != hooks.end(); ++it) {
+      if (!(*it)->isReadonly()) {
+        (*it)->serialize(out);
       }
-
-      result += "\t";
-      result += (*it)->toString();
     }
-
-    return result;
   }
 
   JsonDocument toJson() {
     JsonDocument doc;
-    if (_hooks.size() == 0) {
+    if (!haveHooks()) {
       return doc;
     }
     JsonDocument hooks = getSensorHooksJson();
@@ -150,11 +201,8 @@ class Watcher {
   JsonDocument getSensorHooksJson() {
     JsonDocument doc;
     doc.to<JsonArray>();
-    if (_hooks.size() == 0) {
-      return doc;
-    }
-
-    for (auto it = _hooks.begin(); it != _hooks.end(); ++it) {
+    const std::vector<Hook<T>*> &hooks = _hooks.load()->hooks;
+    for (auto it = hooks.begin(); it != hooks.end(); ++it) {
       if ((*it)->isReadonly()) {
         continue;
       }
@@ -169,30 +217,100 @@ class Watcher {
     return _sensor;
   };
 
-  bool haveHooks() { return _hooks.size() != 0; }
+  const char * name() const {
+    return _sensor->name();
+  }
+
+  // Time (millis) when sensor should be checked next
+  unsigned long nextCheck() const {
+    return _nextCheck;
+  }
+
+  /*
+    Plan next check after the one made at now.
+    First reschedule adds name based phase, so sensors with
+    same interval don't fire in the same tick.
+  */
+  void scheduleNext(unsigned long now) {
+    unsigned long interval = _sensor->interval();
+    if (!_phased) {
+      _phased = true;
+      _nextCheck = now + 1 + hashName(name()) % interval;
+      return;
+    }
+    _nextCheck += interval;
+    if ((long) (now - _nextCheck) >= 0) {
+      // too late, don't try to catch up
+      _nextCheck = now + interval;
+    }
+  }
+
+  bool haveHooks() { return !_hooks.load()->hooks.empty(); }
+
+  uint16_t hooksCount() { return _hooks.load()->hooks.size(); }
 
-  uint8_t hooksCount() { return _hooks.size(); }
+  // Hooks called on the last value change
+  uint16_t lastCalled() const { return _lastCalled; }
 
  protected:
   const Sensor<T> *_sensor;
   T _oldValue;
-  std::list<Hook<T>*> _hooks;
+  // interned id of _oldValue, INTERN_NONE if it has none
+  InternId _oldValueId = INTERN_NONE;
 
  private:
-  int _hookIdSequence;
+  struct HooksSnapshot {
+    // call order is the order hooks were added
+    std::vector<Hook<T>*> hooks;
+    // to know when trigger index is outdated
+    uint32_t version = 0;
+  };
 
-  int getNextHookId() {
-    bool res = false;
-    uint8_t attempts = 20;
-    while (!res && attempts != 0) {
-      _hookIdSequence++;
-      res = getHookById(_hookIdSequence) == nullptr;
-      attempts--;
-    }
-    if (attempts == 0) {
-      return -1;
+  RcuPointer<HooksSnapshot> _hooks;
+  IdAllocator _ids;
+  unsigned long _nextCheck;
+  bool _phased;
+  uint16_t _lastCalled = 0;
+  TriggerIndex<T> _index;
+  // snapshot version index was built for (initial empty snapshot is 0)
+  uint32_t _indexedVersion = 0;
+  // check can come from loop task and from SensorsManager.notify caller
+  Lock _checkLock;
+  // reused between calls of callHooks
+  std::vector<uint16_t> _candidates;
+  // reused between calls of check
+  T _newValue;
+
+  void callHook(Hook<T> * hook, T &value) {
+    if (hook == nullptr || !hook->accept(value)) {
+      return;
     }
-    return _hookIdSequence;
+    _lastCalled++;
+    st_log_debug(
+      _WATCHER_TAG,
+      "Calling hook [id=%d] for sensor %s",
+      hook->getId(),
+      _sensor->name()
+    );
+    hook->call(value);
+    #if ENABLE_EVENTS
+      EventsStream.hookCalled(_sensor->name(), hook->getId(), hookTypeToStr(hook->getType()), value);
+    #endif
+  }
+
+  HooksSnapshot * copyHooks() const {
+    const HooksSnapshot * current = _hooks.load();
+    HooksSnapshot * next = new HooksSnapshot();
+    next->hooks.reserve(current->hooks.size() + 1);
+    next->hooks.assign(current->hooks.begin(), current->hooks.end());
+    next->version = current->version + 1;
+    return next;
+  }
+
+  void publish(HooksSnapshot * next, RcuDomain &rcu) {
+    HooksSnapshot * old = _hooks.load();
+    _hooks.publish(next);
+    rcu.retire(old);
   }
 
   void setInitialValue();
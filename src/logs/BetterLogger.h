@@ -43,6 +43,14 @@
 
 const char * const _LOGGER_TAG = "logger";
 
+// Max length of log line given to sink, longer lines are cut
+#ifndef LOGGER_SINK_MESSAGE_SIZE
+  #define LOGGER_SINK_MESSAGE_SIZE 128
+#endif
+
+// Additional receiver of formatted log lines (events stream)
+typedef void (*LogSink)(uint8_t level, const char * tag, const char * message);
+
 class BetterLogger {
  public:
   BetterLogger() {
@@ -85,9 +93,25 @@ class BetterLogger {
     #endif
   }
 
+  /*
+    Set receiver of log lines, lines are formatted for it only if someone listens
+    @param sink receiver or nullptr
+    @param level min level of lines to pass
+  */
+  void setSink(LogSink sink, uint8_t level) {
+    _sinkLevel = level;
+    _sink = sink;
+  }
+
   #if ENABLE_LOGGER
   template <typename... Args>
   void log(uint8_t level, const char* tag, const char* format, Args... args) {
+    LogSink sink = _sink;
+    if (sink != nullptr && level >= _sinkLevel) {
+      char message[LOGGER_SINK_MESSAGE_SIZE];
+      snprintf(message, LOGGER_SINK_MESSAGE_SIZE, format, args...);
+      sink(level, tag, message);
+    }
     #if LOGGER_TYPE != SERIAL_LOGGER
     if (_connected) {
       if (sendRemote(level, tag, format, args...) <= 0) {
@@ -153,6 +177,8 @@ class BetterLogger {
 
  private:
   const char* _name = "no_name";
+  LogSink _sink = nullptr;
+  uint8_t _sinkLevel = 0;
   #if LOGGER_TYPE == TCP_LOGGER || LOGGER_TYPE == MULTICAST_LOGGER
   bool _connected = false;
   String _fullAddr;
@@ -0,0 +1,199 @@
+#include "net/events/EventsStream.h"
+
+#if ENABLE_EVENTS
+
+#include "logs/BetterLogger.h"
+
+#if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+  #include "sensors/SensorsManager.h"
+#endif
+
+const char * const _EVENTS_TAG = "events";
+const char * const _eventsPing = ": ping\n\n";
+
+struct EventsStreamClass::Client {
+  // ring buffer of formatted events
+  char buffer[EVENTS_CLIENT_BUFFER_SIZE];
+  size_t head = 0;
+  size_t size = 0;
+  uint8_t logLevel = EVENTS_LOGS_OFF;
+  EventsFormat format = EVENTS_FORMAT_SSE;
+  bool evicted = false;
+  unsigned long lastSent = 0;
+
+  void append(const char * data, size_t length) {
+    size_t tail = (head + size) % EVENTS_CLIENT_BUFFER_SIZE;
+    size_t first = EVENTS_CLIENT_BUFFER_SIZE - tail;
+    if (first > length) {
+      first = length;
+    }
+    memcpy(buffer + tail, data, first);
+    memcpy(buffer, data + first, length - first);
+    size += length;
+  }
+};
+
+EventsStreamClass EventsStream;
+
+EventsStreamClass::Client * EventsStreamClass::subscribe(uint8_t logLevel, EventsFormat format) {
+  // built before taking lock, snapshot read doesn't wait
+  #if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+    JsonDocument data;
+    const SensorsSnapshot &snapshot = SensorsManager.getSnapshot();
+    data["seq"] = snapshot.cursor(snapshot.toJson(data["sensors"].to<JsonObject>()));
+    String sensors;
+    serializeJson(data, sensors);
+  #endif
+
+  Client * client = nullptr;
+  {
+    LockGuard guard(_lock);
+    size_t taken = 0;
+    for (size_t i = 0; i < _clientsCount; i++) {
+      if (_clients[i]->format == format) {
+        taken++;
+      }
+    }
+    if (taken >= (format == EVENTS_FORMAT_SSE ? EVENTS_MAX_CLIENTS : EVENTS_INTERNAL_CLIENTS)) {
+      return nullptr;
+    }
+    client = new Client();
+    client->logLevel = logLevel;
+    client->format = format;
+    // first take sends ping if there is nothing else, so headers go out right away
+    client->lastSent = millis() - EVENTS_PING_INTERVAL;
+    _clients[_clientsCount++] = client;
+
+    #if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+      // current values, so subscriber doesn't need separate /sensors request
+      if (sensors.length() + 32 < EVENTS_CLIENT_BUFFER_SIZE) {
+        write(client, "sensors", 7, sensors.c_str(), sensors.length());
+      }
+    #endif
+    updateLogSink();
+  }
+  st_log_debug(_EVENTS_TAG, "New events subscriber, total %u", _clientsCount);
+  return client;
+}
+
+void EventsStreamClass::unsubscribe(Client * client) {
+  {
+    LockGuard guard(_lock);
+    for (size_t i = 0; i < _clientsCount; i++) {
+      if (_clients[i] == client) {
+        _clients[i] = _clients[--_clientsCount];
+        _clients[_clientsCount] = nullptr;
+        break;
+      }
+    }
+    delete client;
+    updateLogSink();
+  }
+  st_log_debug(_EVENTS_TAG, "Events subscriber left, total %u", _clientsCount);
+}
+
+int EventsStreamClass::take(Client * client, uint8_t * buffer, size_t maxLength) {
+  LockGuard guard(_lock);
+  if (client->evicted) {
+    return -1;
+  }
+
+  if (client->size == 0) {
+    if (client->format != EVENTS_FORMAT_SSE) {
+      return 0;
+    }
+    size_t pingLength = strlen(_eventsPing);
+    if (millis() - client->lastSent < EVENTS_PING_INTERVAL || maxLength < pingLength) {
+      return 0;
+    }
+    memcpy(buffer, _eventsPing, pingLength);
+    client->lastSent = millis();
+    return pingLength;
+  }
+
+  size_t length = client->size < maxLength ? client->size : maxLength;
+  size_t first = EVENTS_CLIENT_BUFFER_SIZE - client->head;
+  if (first > length) {
+    first = length;
+  }
+  memcpy(buffer, client->buffer + client->head, first);
+  memcpy(buffer + first, client->buffer, length - first);
+  client->head = (client->head + length) % EVENTS_CLIENT_BUFFER_SIZE;
+  client->size -= length;
+  client->lastSent = millis();
+  return length;
+}
+
+void EventsStreamClass::hookResult(const char * sensor, int id, const char * type, int code) {
+  if (!hasClients()) {
+    return;
+  }
+  JsonDocument data;
+  data["sensor"] = sensor;
+  data["id"] = id;
+  data["type"] = type;
+  data["code"] = code;
+  send("hookResult", data);
+}
+
+void EventsStreamClass::send(const char * event, JsonDocument &data, uint8_t logLevel) {
+  // compact json has no line breaks, so it fits one data line
+  String json;
+  serializeJson(data, json);
+  size_t eventLength = strlen(event);
+
+  LockGuard guard(_lock);
+  for (size_t i = 0; i < _clientsCount; i++) {
+    Client * client = _clients[i];
+    if (client->evicted || (logLevel != 0 && logLevel < client->logLevel)) {
+      continue;
+    }
+    write(client, event, eventLength, json.c_str(), json.length());
+  }
+}
+
+void EventsStreamClass::write(Client * client, const char * event, size_t eventLength, const char * data, size_t dataLength) {
+  bool sse = client->format == EVENTS_FORMAT_SSE;
+  // event: <event>\ndata: <data>\n\n or {"ev":"<event>","data":<data>}\n
+  size_t length = sse ? 7 + eventLength + 7 + dataLength + 2 : 7 + eventLength + 9 + dataLength + 2;
+  if (EVENTS_CLIENT_BUFFER_SIZE - client->size < length) {
+    // subscriber doesn't read fast enough, its stream is closed (browser reconnects by itself)
+    client->evicted = true;
+    client->size = 0;
+    _evicted++;
+    return;
+  }
+  if (sse) {
+    client->append("event: ", 7);
+    client->append(event, eventLength);
+    client->append("\ndata: ", 7);
+    client->append(data, dataLength);
+    client->append("\n\n", 2);
+  } else {
+    client->append("{\"ev\":\"", 7);
+    client->append(event, eventLength);
+    client->append("\",\"data\":", 9);
+    client->append(data, dataLength);
+    client->append("}\n", 2);
+  }
+}
+
+void EventsStreamClass::updateLogSink() {
+  uint8_t level = EVENTS_LOGS_OFF;
+  for (size_t i = 0; i < _clientsCount; i++) {
+    if (_clients[i]->logLevel < level) {
+      level = _clients[i]->logLevel;
+    }
+  }
+  LOGGER.setSink(level == EVENTS_LOGS_OFF ? nullptr : &EventsStreamClass::logSink, level);
+}
+
+void EventsStreamClass::logSink(uint8_t level, const char * tag, const char * message) {
+  JsonDocument data;
+  data["level"] = level;
+  data["tag"] = tag;
+  data["message"] = message;
+  EventsStream.send("log", data, level);
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef EVENTS_STREAM_H
+#define EVENTS_STREAM_H
+
+#include "Features.h"
+
+#if ENABLE_EVENTS
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "utils/Lock.h"
+
+// Max concurrent /events subscribers, others get 503
+#ifndef EVENTS_MAX_CLIENTS
+  #ifdef ARDUINO_ARCH_ESP32
+    #define EVENTS_MAX_CLIENTS 4
+  #else
+    #define EVENTS_MAX_CLIENTS 2
+  #endif
+#endif
+
+// Bytes of events waiting for sending to one subscriber, subscriber which lets it overflow is evicted
+#ifndef EVENTS_CLIENT_BUFFER_SIZE
+  #ifdef ARDUINO_ARCH_ESP32
+    #define EVENTS_CLIENT_BUFFER_SIZE 2048
+  #else
+    #define EVENTS_CLIENT_BUFFER_SIZE 1024
+  #endif
+#endif
+
+// Comment line is sent to idle subscriber after this time, so proxies don't close connection
+#ifndef EVENTS_PING_INTERVAL
+  #define EVENTS_PING_INTERVAL 15000 // ms
+#endif
+
+// Subscriber doesn't get log lines
+#define EVENTS_LOGS_OFF 0xFF
+
+// Slots for internal subscribers (gateway connection), they don't take EVENTS_MAX_CLIENTS ones
+#define EVENTS_INTERNAL_CLIENTS ENABLE_GATEWAY_WS
+
+enum EventsFormat {
+  // event: <event>\ndata: <json>\n\n with comment pings, for /events
+  EVENTS_FORMAT_SSE,
+  // {"ev":"<event>","data":<json>}\n, whole events only, for internal subscribers
+  EVENTS_FORMAT_LINES
+};
+
+/*
+  Server-Sent Events for /events subscribers: sensor changes, hook calls and their results, log lines.
+  Publishers (loop task, dispatcher workers, any logging task) put formatted events
+  into bounded buffer of each subscriber, web server task takes them from there
+  (see EventsRequestHandler), so publishers never wait for network.
+*/
+class EventsStreamClass {
+  public:
+    struct Client;
+
+    /*
+      Register new subscriber
+      @param logLevel min level of log lines to send, EVENTS_LOGS_OFF - no logs
+      @param format events format, EVENTS_FORMAT_LINES subscribers use EVENTS_INTERNAL_CLIENTS slots
+      @returns nullptr if all slots for this format are taken
+    */
+    Client * subscribe(uint8_t logLevel, EventsFormat format = EVENTS_FORMAT_SSE);
+
+    // Called when subscriber connection is closed, client is deleted
+    void unsubscribe(Client * client);
+
+    /*
+      Take buffered events of subscriber, only from task which serves it.
+      With maxLength >= EVENTS_CLIENT_BUFFER_SIZE all buffered events are taken, so no event is cut.
+      @returns bytes written to buffer, 0 if there is nothing to send yet, -1 if client was evicted
+    */
+    int take(Client * client, uint8_t * buffer, size_t maxLength);
+
+    // Publishers check it before building events
+    bool hasClients() const {
+      return _clientsCount > 0;
+    }
+
+    template <typename T>
+    void sensorChanged(const char * sensor, const T &value, const String &seq) {
+      if (!hasClients()) {
+        return;
+      }
+      JsonDocument data;
+      data["sensor"] = sensor;
+      data["value"] = value;
+      data["seq"] = seq;
+      send("sensor", data);
+    }
+
+    template <typename T>
+    void hookCalled(const char * sensor, int id, const char * type, const T &value) {
+      if (!hasClients()) {
+        return;
+      }
+      JsonDocument data;
+      data["sensor"] = sensor;
+      data["id"] = id;
+      data["type"] = type;
+      data["value"] = value;
+      send("hook", data);
+    }
+
+    // @param code http code of hook request or error code (< 0)
+    void hookResult(const char * sensor, int id, const char * type, int code);
+
+    size_t clients() const { return _clientsCount; }
+    unsigned long evicted() const { return _evicted; }
+
+  private:
+    Client * _clients[EVENTS_MAX_CLIENTS + EVENTS_INTERNAL_CLIENTS] = {};
+    size_t _clientsCount = 0;
+    unsigned long _evicted = 0;
+    Lock _lock;
+
+    /*
+      Put event in buffers of subscribers
+      @param logLevel level of log line, 0 for other events
+    */
+    void send(const char * event, JsonDocument &data, uint8_t logLevel = 0);
+
+    // Write event into client buffer or evict client if it doesn't fit, lock must be held
+    void write(Client * client, const char * event, size_t eventLength, const char * data, size_t dataLength);
+
+    // Tell logger min log level subscribers want, lock must be held
+    void updateLogSink();
+
+    static void logSink(uint8_t level, const char * tag, const char * message);
+};
+
+extern EventsStreamClass EventsStream;
+
+#endif
+
+#endif
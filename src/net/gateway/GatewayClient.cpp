@@ -0,0 +1,508 @@
+#include "net/gateway/GatewayClient.h"
+
+#if ENABLE_GATEWAY_WS
+
+#include <base64.h>
+
+#include "SmartThing.h"
+#include "logs/BetterLogger.h"
+#include "config/ConfigManager.h"
+
+const char * const _GATEWAY_CLIENT_TAG = "gateway_ws";
+
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+GatewayClientClass GatewayClient;
+
+// Gateway address is ip:port or http://host:port, as for notifications
+static bool parseGateway(const String &gateway, String &host, uint16_t &port) {
+  int start = 0;
+  if (gateway.startsWith("http://")) {
+    start = 7;
+  } else if (gateway.startsWith("ws://")) {
+    start = 5;
+  } else if (gateway.indexOf("://") >= 0) {
+    // no tls
+    return false;
+  }
+
+  int end = start;
+  while (end < (int) gateway.length() && gateway.charAt(end) != '/') {
+    end++;
+  }
+  String authority = gateway.substring(start, end);
+  int colon = authority.indexOf(':');
+  if (colon >= 0) {
+    host = authority.substring(0, colon);
+    port = authority.substring(colon + 1).toInt();
+  } else {
+    host = authority;
+    port = 80;
+  }
+  return !host.isEmpty() && port != 0;
+}
+
+void GatewayClientClass::begin() {
+  xTaskCreate(
+    [](void * o) {
+      const TickType_t xDelay = GATEWAY_WS_TASK_DELAY / portTICK_PERIOD_MS;
+      while (true) {
+        GatewayClient.tick();
+        vTaskDelay(xDelay);
+      }
+    },
+    "st-gateway", GATEWAY_WS_TASK_STACK, NULL, 1, NULL
+  );
+  st_log_debug(_GATEWAY_CLIENT_TAG, "Gateway connection task started");
+}
+
+void GatewayClientClass::tick() {
+  uint32_t version = ConfigManager.version();
+  if (version != _configVersion) {
+    _configVersion = version;
+    String gateway = ConfigManager.get(GATEWAY_CONFIG);
+    if (!gateway.equals(_gateway)) {
+      if (_connected) {
+        disconnect("gateway address changed", 1001);
+      }
+      _gateway = gateway;
+      _backoff = 0;
+      _retryDelay = 0;
+    }
+  }
+
+  if (!_connected) {
+    if (_gateway.isEmpty() || !WiFi.isConnected() || millis() - _lastAttempt < _retryDelay) {
+      return;
+    }
+    connect();
+    return;
+  }
+
+  if (!_client.connected()) {
+    disconnect("connection lost");
+    return;
+  }
+  if (!receive()) {
+    return;
+  }
+
+  int length = EventsStream.take(_events, _tx, sizeof(_tx));
+  if (length < 0) {
+    // events were lost, gateway gets all values again instead
+    st_log_warning(_GATEWAY_CLIENT_TAG, "Gateway doesn't keep up with events, resubscribing");
+    EventsStream.unsubscribe(_events);
+    _events = EventsStream.subscribe(EVENTS_LOGS_OFF, EVENTS_FORMAT_LINES);
+  } else if (length > 0) {
+    if (!sendFrame(WS_OPCODE_TEXT, _tx, length)) {
+      disconnect("send failed");
+      return;
+    }
+    _messages++;
+  }
+
+  unsigned long now = millis();
+  if (now - _lastReceived > 2 * GATEWAY_WS_PING_INTERVAL) {
+    disconnect("gateway doesn't answer", 1001);
+  } else if (now - _lastReceived > GATEWAY_WS_PING_INTERVAL && now - _lastPing > GATEWAY_WS_PING_INTERVAL) {
+    sendFrame(WS_OPCODE_PING, nullptr, 0);
+    _lastPing = now;
+  }
+}
+
+bool GatewayClientClass::connect() {
+  _lastAttempt = millis();
+  String host;
+  uint16_t port;
+  if (!parseGateway(_gateway, host, port)) {
+    st_log_error(_GATEWAY_CLIENT_TAG, "Unsupported gateway address %s", _gateway.c_str());
+    _retryDelay = GATEWAY_WS_RECONNECT_MAX;
+    return false;
+  }
+
+  st_log_debug(_GATEWAY_CLIENT_TAG, "Connecting to ws://%s:%u%s", host.c_str(), port, GATEWAY_WS_PATH);
+  if (!_client.connect(host.c_str(), port, GATEWAY_WS_CONNECT_TIMEOUT) || !handshake(host, port)) {
+    _client.stop();
+    scheduleReconnect();
+    st_log_warning(_GATEWAY_CLIENT_TAG, "Failed to connect to gateway, next attempt in %lu ms", _retryDelay);
+    return false;
+  }
+
+  _client.setNoDelay(true);
+  _rxLength = 0;
+  _connectedAt = millis();
+  _lastReceived = _connectedAt;
+  _lastPing = _connectedAt;
+  _connected = true;
+  _connects++;
+
+  if (!sendHello()) {
+    disconnect("send failed");
+    return false;
+  }
+  _events = EventsStream.subscribe(EVENTS_LOGS_OFF, EVENTS_FORMAT_LINES);
+  st_log_info(_GATEWAY_CLIENT_TAG, "Connected to gateway %s:%u", host.c_str(), port);
+  return true;
+}
+
+bool GatewayClientClass::handshake(const String &host, uint16_t port) {
+  uint8_t nonce[16];
+  for (uint8_t i = 0; i < sizeof(nonce); i++) {
+    nonce[i] = random(256);
+  }
+
+  String request;
+  request.reserve(192);
+  request += "GET " GATEWAY_WS_PATH " HTTP/1.1\r\nHost: ";
+  request += host;
+  request += ':';
+  request += port;
+  request += "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Key: ";
+  request += base64::encode(nonce, sizeof(nonce));
+  request += "\r\n\r\n";
+  if (_client.write((const uint8_t *) request.c_str(), request.length()) != request.length()) {
+    return false;
+  }
+
+  // Sec-WebSocket-Accept isn't checked: gateway is trusted as much as for http hooks
+  unsigned long started = millis();
+  String line;
+  if (!readLine(line, started) || !line.startsWith("HTTP/1.1 101")) {
+    st_log_error(_GATEWAY_CLIENT_TAG, "Gateway refused websocket: %s", line.c_str());
+    return false;
+  }
+  do {
+    line.clear();
+    if (!readLine(line, started)) {
+      return false;
+    }
+  } while (!line.isEmpty());
+  return true;
+}
+
+bool GatewayClientClass::readLine(String &line, unsigned long started) {
+  while (millis() - started < GATEWAY_WS_CONNECT_TIMEOUT) {
+    while (_client.available()) {
+      char c = _client.read();
+      if (c == '\n') {
+        return true;
+      }
+      if (c != '\r') {
+        line += c;
+      }
+    }
+    if (!_client.connected()) {
+      return false;
+    }
+    delay(1);
+  }
+  return false;
+}
+
+void GatewayClientClass::disconnect(const char * reason, uint16_t code) {
+  if (_client.connected()) {
+    uint8_t payload[2] = {(uint8_t) (code >> 8), (uint8_t) (code & 0xFF)};
+    sendFrame(WS_OPCODE_CLOSE, payload, 2);
+  }
+  _client.stop();
+
+  if (_events != nullptr) {
+    EventsStream.unsubscribe(_events);
+    _events = nullptr;
+  }
+  _rxLength = 0;
+
+  if (_connected) {
+    _connected = false;
+    // connection which dies right after connect doesn't reset backoff, so gateway isn't hammered
+    if (millis() - _connectedAt > GATEWAY_WS_PING_INTERVAL) {
+      _backoff = 0;
+    }
+    scheduleReconnect();
+  }
+  _lastAttempt = millis();
+  st_log_warning(_GATEWAY_CLIENT_TAG, "Gateway connection closed (%s), reconnect in %lu ms", reason, _retryDelay);
+}
+
+void GatewayClientClass::scheduleReconnect() {
+  if (_backoff == 0) {
+    _backoff = GATEWAY_WS_RECONNECT_MIN;
+  } else {
+    _backoff = _backoff * 2 > GATEWAY_WS_RECONNECT_MAX ? GATEWAY_WS_RECONNECT_MAX : _backoff * 2;
+  }
+  // jitter, so devices don't come back all at once after gateway restart
+  _retryDelay = _backoff + random(_backoff / 4 + 1);
+}
+
+bool GatewayClientClass::receive() {
+  while (_client.available() > 0) {
+    int read = _client.read(_rx + _rxLength, sizeof(_rx) - _rxLength);
+    if (read <= 0) {
+      break;
+    }
+    _rxLength += read;
+    _lastReceived = millis();
+
+    size_t offset = 0;
+    while (_rxLength - offset >= 2) {
+      uint8_t * frame = _rx + offset;
+      size_t available = _rxLength - offset;
+      bool fin = frame[0] & 0x80;
+      uint8_t opcode = frame[0] & 0x0F;
+      bool masked = frame[1] & 0x80;
+      uint64_t length = frame[1] & 0x7F;
+      size_t header = 2;
+      if (length == 126) {
+        if (available < 4) {
+          break;
+        }
+        length = ((uint16_t) frame[2] << 8) | frame[3];
+        header = 4;
+      } else if (length == 127) {
+        if (available < 10) {
+          break;
+        }
+        length = 0;
+        for (uint8_t i = 2; i < 10; i++) {
+          length = (length << 8) | frame[i];
+        }
+        header = 10;
+      }
+      if (masked) {
+        header += 4;
+      }
+
+      if (length > sizeof(_rx) - header) {
+        disconnect("message is too big", 1009);
+        return false;
+      }
+      if (available < header + length) {
+        break;
+      }
+      if (!fin || opcode == 0) {
+        disconnect("fragmented messages are not supported", 1003);
+        return false;
+      }
+
+      uint8_t * payload = frame + header;
+      if (masked) {
+        const uint8_t * mask = payload - 4;
+        for (size_t i = 0; i < length; i++) {
+          payload[i] ^= mask[i & 3];
+        }
+      }
+      if (!handleFrame(opcode, payload, length)) {
+        return false;
+      }
+      offset += header + length;
+    }
+
+    if (offset > 0) {
+      memmove(_rx, _rx + offset, _rxLength - offset);
+      _rxLength -= offset;
+    }
+  }
+  return true;
+}
+
+bool GatewayClientClass::handleFrame(uint8_t opcode, uint8_t * payload, size_t length) {
+  switch (opcode) {
+    case WS_OPCODE_TEXT: {
+      JsonDocument command;
+      DeserializationError error = deserializeJson(command, (const char *) payload, length);
+      JsonDocument reply;
+      if (error) {
+        st_log_error(_GATEWAY_CLIENT_TAG, "Failed to parse command: %s", error.c_str());
+        reply["code"] = 400;
+        reply["error"] = "Bad json";
+      } else {
+        handleCommand(command, reply);
+      }
+      _commands++;
+      if (!sendJson(reply)) {
+        disconnect("send failed");
+        return false;
+      }
+      return true;
+    }
+    case WS_OPCODE_PING:
+      if (!sendFrame(WS_OPCODE_PONG, payload, length)) {
+        disconnect("send failed");
+        return false;
+      }
+      return true;
+    case WS_OPCODE_PONG:
+      return true;
+    case WS_OPCODE_CLOSE:
+      disconnect("closed by gateway", length >= 2 ? ((uint16_t) payload[0] << 8) | payload[1] : 1000);
+      return false;
+    default:
+      st_log_warning(_GATEWAY_CLIENT_TAG, "Unsupported frame opcode %u", opcode);
+      return true;
+  }
+}
+
+void GatewayClientClass::handleCommand(JsonDocument &command, JsonDocument &reply) {
+  reply["id"] = command["id"];
+  const char * op = command["op"];
+  if (op == nullptr) {
+    reply["code"] = 400;
+    reply["error"] = "Op is missing";
+    return;
+  }
+  st_log_debug(_GATEWAY_CLIENT_TAG, "Gateway command %s", op);
+
+  #if ENABLE_ACTIONS
+    if (strcmp(op, "action") == 0) {
+      const char * name = command["name"];
+      if (name == nullptr) {
+        reply["code"] = 400;
+        reply["error"] = "Action name is missing";
+        return;
+      }
+      switch (ActionsManager.call(name)) {
+        case ACTION_RESULT_SUCCESS:
+          reply["code"] = 200;
+          break;
+        case ACTION_RESULT_ERROR:
+          reply["code"] = 500;
+          reply["error"] = "Failed to execute action";
+          break;
+        default:
+          reply["code"] = 404;
+          reply["error"] = "Failed to find action with given name";
+      }
+      return;
+    }
+  #endif
+
+  #if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+    if (strcmp(op, "sensors") == 0) {
+      reply["code"] = 200;
+      const SensorsSnapshot &snapshot = SensorsManager.getSnapshot();
+      reply["seq"] = snapshot.cursor(snapshot.toJson(reply["data"].to<JsonObject>()));
+      return;
+    }
+  #endif
+
+  if (strcmp(op, "config") == 0) {
+    // same as POST /config: missing entries are cleared
+    if (ConfigManager.setConfig(command["config"])) {
+      reply["code"] = 200;
+    } else {
+      reply["code"] = 500;
+      reply["error"] = "Failed to save config";
+    }
+    return;
+  }
+
+  #if ENABLE_HOOKS
+    if (strncmp(op, "hooks", 5) == 0) {
+      const char * sensor = command["sensor"];
+      if (sensor == nullptr) {
+        reply["code"] = 400;
+        reply["error"] = "Sensor is missing";
+        return;
+      }
+
+      if (strcmp(op, "hooks") == 0) {
+        reply["code"] = 200;
+        reply["data"] = HooksManager.getSensorHooksJson(sensor);
+      } else if (strcmp(op, "hooks.add") == 0) {
+        int id = HooksManager.add(sensor, command["hook"].as<String>().c_str());
+        if (id >= 0) {
+          reply["code"] = 201;
+          reply["data"]["id"] = id;
+        } else {
+          reply["code"] = 500;
+          reply["error"] = "Failed to create hook";
+        }
+      } else if (strcmp(op, "hooks.update") == 0) {
+        if (HooksManager.update(command)) {
+          reply["code"] = 200;
+        } else {
+          reply["code"] = 500;
+          reply["error"] = "Failed to update hook";
+        }
+      } else if (strcmp(op, "hooks.delete") == 0) {
+        if (HooksManager.remove(sensor, command["id"] | -1)) {
+          reply["code"] = 200;
+        } else {
+          reply["code"] = 500;
+          reply["error"] = "Failed to delete hook";
+        }
+      } else {
+        reply["code"] = 404;
+        reply["error"] = "Unknown op";
+      }
+      return;
+    }
+  #endif
+
+  reply["code"] = 404;
+  reply["error"] = "Unknown op";
+}
+
+bool GatewayClientClass::sendFrame(uint8_t opcode, const uint8_t * data, size_t length) {
+  uint8_t header[14];
+  size_t headerLength = 0;
+  header[headerLength++] = 0x80 | opcode;
+  // client frames are always masked
+  if (length < 126) {
+    header[headerLength++] = 0x80 | length;
+  } else if (length <= 0xFFFF) {
+    header[headerLength++] = 0x80 | 126;
+    header[headerLength++] = length >> 8;
+    header[headerLength++] = length & 0xFF;
+  } else {
+    header[headerLength++] = 0x80 | 127;
+    for (int8_t i = 7; i >= 0; i--) {
+      header[headerLength++] = i < 4 ? (uint64_t) length >> (i * 8) & 0xFF : 0;
+    }
+  }
+  uint8_t * mask = header + headerLength;
+  for (uint8_t i = 0; i < 4; i++) {
+    mask[i] = random(256);
+  }
+  headerLength += 4;
+
+  if (_client.write(header, headerLength) != headerLength) {
+    return false;
+  }
+
+  uint8_t chunk[128];
+  for (size_t offset = 0; offset < length; offset += sizeof(chunk)) {
+    size_t size = length - offset < sizeof(chunk) ? length - offset : sizeof(chunk);
+    for (size_t i = 0; i < size; i++) {
+      chunk[i] = data[offset + i] ^ mask[(offset + i) & 3];
+    }
+    if (_client.write(chunk, size) != size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GatewayClientClass::sendJson(JsonDocument &doc) {
+  String message;
+  serializeJson(doc, message);
+  message += '\n';
+  return sendFrame(WS_OPCODE_TEXT, (const uint8_t *) message.c_str(), message.length());
+}
+
+bool GatewayClientClass::sendHello() {
+  JsonDocument hello;
+  hello["ev"] = "hello";
+  JsonObject data = hello["data"].to<JsonObject>();
+  data["name"] = SmartThing.getName();
+  data["type"] = SmartThing.getType();
+  data["ip"] = SmartThing.getIp();
+  data["stVersion"] = SMART_THING_VERSION;
+  return sendJson(hello);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef GATEWAY_CLIENT_H
+#define GATEWAY_CLIENT_H
+
+#include "Features.h"
+
+#if ENABLE_GATEWAY_WS
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFiClient.h>
+
+#include "net/events/EventsStream.h"
+
+// Websocket endpoint path on gateway
+#ifndef GATEWAY_WS_PATH
+  #define GATEWAY_WS_PATH "/api/device/ws"
+#endif
+
+// First reconnect delay (ms), it is doubled after every failed attempt up to GATEWAY_WS_RECONNECT_MAX
+#ifndef GATEWAY_WS_RECONNECT_MIN
+  #define GATEWAY_WS_RECONNECT_MIN 1000
+#endif
+
+#ifndef GATEWAY_WS_RECONNECT_MAX
+  #define GATEWAY_WS_RECONNECT_MAX 60000
+#endif
+
+// Tcp connect and handshake timeout (ms)
+#ifndef GATEWAY_WS_CONNECT_TIMEOUT
+  #define GATEWAY_WS_CONNECT_TIMEOUT 2000
+#endif
+
+// Ping is sent when nothing came from gateway for this time, after two intervals connection is dropped (ms)
+#ifndef GATEWAY_WS_PING_INTERVAL
+  #define GATEWAY_WS_PING_INTERVAL 15000
+#endif
+
+// Max incoming message size with frame header, gateway is disconnected if it sends bigger one
+#ifndef GATEWAY_WS_RX_BUFFER_SIZE
+  #define GATEWAY_WS_RX_BUFFER_SIZE 1024
+#endif
+
+#ifndef GATEWAY_WS_TASK_STACK
+  #define GATEWAY_WS_TASK_STACK 8192
+#endif
+
+// Connection task poll interval (ms)
+#ifndef GATEWAY_WS_TASK_DELAY
+  #define GATEWAY_WS_TASK_DELAY 10
+#endif
+
+/*
+  Persistent websocket connection from device to gateway (GATEWAY_CONFIG).
+  Gateway sends commands as text messages and gets reply with the same id:
+    {"id":<n>,"op":"<op>",...} -> {"id":<n>,"code":<http code>[,"data":...][,"error":"..."]}
+  Device messages are one or more lines of json (events are batched):
+    {"ev":"<event>","data":{...}}\n
+  Events are the same as in /events stream (see EventsStream), the first ones after connect
+  are "hello" with device info and "sensors" with all values.
+  Connection is served by own task, connect and handshake block only it (esp32 only).
+*/
+class GatewayClientClass {
+  public:
+    // Starts connection task
+    void begin();
+
+    // Connects, executes commands and sends events
+    void tick();
+
+    bool connected() const { return _connected; }
+    unsigned long connects() const { return _connects; }
+    unsigned long commands() const { return _commands; }
+    unsigned long messages() const { return _messages; }
+
+  private:
+    WiFiClient _client;
+    volatile bool _connected = false;
+    EventsStreamClass::Client * _events = nullptr;
+
+    String _gateway;
+    uint32_t _configVersion = 0;
+    unsigned long _backoff = 0;
+    unsigned long _retryDelay = 0;
+    unsigned long _lastAttempt = 0;
+    unsigned long _connectedAt = 0;
+    unsigned long _lastReceived = 0;
+    unsigned long _lastPing = 0;
+
+    uint8_t _rx[GATEWAY_WS_RX_BUFFER_SIZE];
+    size_t _rxLength = 0;
+    // all buffered events are taken at once, so message never ends with cut event
+    uint8_t _tx[EVENTS_CLIENT_BUFFER_SIZE];
+
+    unsigned long _connects = 0;
+    unsigned long _commands = 0;
+    unsigned long _messages = 0;
+
+    bool connect();
+    bool handshake(const String &host, uint16_t port);
+    bool readLine(String &line, unsigned long started);
+    /*
+      Close connection and schedule reconnect
+      @param code websocket close code sent to gateway
+    */
+    void disconnect(const char * reason, uint16_t code = 1000);
+    void scheduleReconnect();
+
+    // Read incoming frames, @returns false if connection was closed
+    bool receive();
+    bool handleFrame(uint8_t opcode, uint8_t * payload, size_t length);
+    void handleCommand(JsonDocument &command, JsonDocument &reply);
+
+    bool sendFrame(uint8_t opcode, const uint8_t * data, size_t length);
+    bool sendJson(JsonDocument &doc);
+    bool sendHello();
+};
+
+extern GatewayClientClass GatewayClient;
+
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+#include "net/http/HttpConnectionPool.h"
+
+#if ENABLE_HOOKS
+
+#include "logs/BetterLogger.h"
+
+const char * const _HTTP_POOL_TAG = "http_pool";
+
+HttpConnectionPoolClass HttpConnectionPool;
+
+bool HttpConnectionPoolClass::parseHost(const String &url, String &host, uint16_t &port) {
+  int start = 0;
+  if (url.startsWith("http://")) {
+    start = 7;
+  } else if (url.indexOf("://") >= 0) {
+    // https and others can't be served by plain WiFiClient
+    return false;
+  }
+
+  int end = start;
+  while (end < (int) url.length() && url.charAt(end) != '/' && url.charAt(end) != '?') {
+    end++;
+  }
+  String authority = url.substring(start, end);
+  int at = authority.lastIndexOf('@');
+  if (at >= 0) {
+    authority = authority.substring(at + 1);
+  }
+  int colon = authority.indexOf(':');
+  if (colon >= 0) {
+    host = authority.substring(0, colon);
+    port = authority.substring(colon + 1).toInt();
+  } else {
+    host = authority;
+    port = 80;
+  }
+  return !host.isEmpty() && port != 0;
+}
+
+HttpConnectionPoolClass::Connection * HttpConnectionPoolClass::acquire(const String &url) {
+  String host;
+  uint16_t port;
+  if (!parseHost(url, host, port)) {
+    return nullptr;
+  }
+
+  LockGuard guard(_lock);
+  Connection * found = nullptr;
+  Connection * oldest = nullptr;
+  for (size_t i = 0; i < HTTP_POOL_MAX_CONNECTIONS; i++) {
+    Connection &connection = _connections[i];
+    if (connection.busy) {
+      continue;
+    }
+    if (connection.port == port && connection.host == host) {
+      found = &connection;
+      break;
+    }
+    if (oldest == nullptr || connection.port == 0 ||
+        (oldest->port != 0 && connection.lastUsed < oldest->lastUsed)) {
+      oldest = &connection;
+    }
+  }
+
+  if (found == nullptr) {
+    if (oldest == nullptr) {
+      st_log_debug(_HTTP_POOL_TAG, "All connections are busy");
+      return nullptr;
+    }
+    // slot goes to another host, its connection can't be reused
+    close(*oldest);
+    oldest->host = host;
+    oldest->port = port;
+    found = oldest;
+  }
+
+  if (found->client.connected()) {
+    _reused++;
+  } else {
+    _opened++;
+  }
+  found->busy = true;
+  return found;
+}
+
+void HttpConnectionPoolClass::release(Connection * connection, bool keep) {
+  if (connection == nullptr) {
+    return;
+  }
+  LockGuard guard(_lock);
+  if (!keep) {
+    connection->client.stop();
+  }
+  connection->lastUsed = millis();
+  connection->busy = false;
+}
+
+void HttpConnectionPoolClass::evictIdle() {
+  LockGuard guard(_lock);
+  unsigned long now = millis();
+  for (size_t i = 0; i < HTTP_POOL_MAX_CONNECTIONS; i++) {
+    Connection &connection = _connections[i];
+    if (!connection.busy && connection.port != 0 && now - connection.lastUsed > HTTP_POOL_IDLE_TIMEOUT) {
+      close(connection);
+    }
+  }
+}
+
+void HttpConnectionPoolClass::close(Connection &connection) {
+  if (connection.client.connected()) {
+    st_log_debug(_HTTP_POOL_TAG, "Closing connection to %s:%u", connection.host.c_str(), connection.port);
+    _evicted++;
+  }
+  connection.client.stop();
+  connection.host.clear();
+  connection.port = 0;
+}
+
+size_t HttpConnectionPoolClass::active() {
+  LockGuard guard(_lock);
+  size_t count = 0;
+  for (size_t i = 0; i < HTTP_POOL_MAX_CONNECTIONS; i++) {
+    if (_connections[i].busy || _connections[i].client.connected()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+PooledHttpClient::PooledHttpClient(const String &url) {
+  _connection = HttpConnectionPool.acquire(url);
+  if (_connection != nullptr) {
+    _connection->http.setReuse(true);
+    _connection->http.setTimeout(HTTP_POOL_REQUEST_TIMEOUT);
+    if (_connection->http.begin(_connection->client, url)) {
+      return;
+    }
+    HttpConnectionPool.release(_connection, false);
+    _connection = nullptr;
+  }
+
+  _tmpHttp.setReuse(false);
+  _tmpHttp.setTimeout(HTTP_POOL_REQUEST_TIMEOUT);
+  #ifdef ARDUINO_ARCH_ESP32
+    _tmpHttp.begin(url);
+  #endif
+  #ifdef ARDUINO_ARCH_ESP8266
+    _tmpHttp.begin(_tmpClient, url);
+  #endif
+}
+
+PooledHttpClient::~PooledHttpClient() {
+  http().end();
+  if (_connection != nullptr) {
+    HttpConnectionPool.release(_connection, _keep);
+  }
+}
+
+void PooledHttpClient::addHeader(const char * name, const char * value) {
+  http().addHeader(name, value);
+}
+
+int PooledHttpClient::sendRequest(const char * method, const char * payload) {
+  int code = http().sendRequest(method, payload);
+  // negative codes are transport errors, connection state is unknown
+  _keep = code > 0;
+  return code;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef HTTP_CONNECTION_POOL_H
+#define HTTP_CONNECTION_POOL_H
+
+#include "Features.h"
+
+#if ENABLE_HOOKS
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <HTTPClient.h>
+#endif
+#ifdef ARDUINO_ARCH_ESP8266
+#include <ESP8266HTTPClient.h>
+#endif
+#include <WiFiClient.h>
+
+#include "utils/Lock.h"
+
+// Max keep-alive connections shared by all hooks
+#ifndef HTTP_POOL_MAX_CONNECTIONS
+  #ifdef ARDUINO_ARCH_ESP32
+    #define HTTP_POOL_MAX_CONNECTIONS 4
+  #else
+    #define HTTP_POOL_MAX_CONNECTIONS 2
+  #endif
+#endif
+
+// Idle connections older than this are closed (ms)
+#ifndef HTTP_POOL_IDLE_TIMEOUT
+  #define HTTP_POOL_IDLE_TIMEOUT 30000
+#endif
+
+#define HTTP_POOL_REQUEST_TIMEOUT 2000
+
+/*
+  Keep-alive connections to http servers, one per host:port slot.
+  HTTPClient stops its WiFiClient in destructor, so both live in the pool
+  and are reused together.
+*/
+class HttpConnectionPoolClass {
+  public:
+    struct Connection {
+      String host;
+      uint16_t port = 0;
+      bool busy = false;
+      unsigned long lastUsed = 0;
+      WiFiClient client;
+      HTTPClient http;
+    };
+
+    /*
+      Take connection for url's host:port
+      @param url request url
+      @returns nullptr if url can't be pooled or all connections are busy
+    */
+    Connection * acquire(const String &url);
+
+    /*
+      Return connection back to the pool
+      @param keep false if connection is broken and must be closed
+    */
+    void release(Connection * connection, bool keep);
+
+    // Close connections idle longer than HTTP_POOL_IDLE_TIMEOUT
+    void evictIdle();
+
+    size_t active();
+    unsigned long opened() { return _opened; }
+    unsigned long reused() { return _reused; }
+    unsigned long evicted() { return _evicted; }
+  private:
+    Connection _connections[HTTP_POOL_MAX_CONNECTIONS];
+    unsigned long _opened = 0;
+    unsigned long _reused = 0;
+    unsigned long _evicted = 0;
+    Lock _lock;
+
+    bool parseHost(const String &url, String &host, uint16_t &port);
+    void close(Connection &connection);
+};
+
+extern HttpConnectionPoolClass HttpConnectionPool;
+
+/*
+  Http client for a single request.
+  Uses pooled connection when possible, otherwise falls back to a temporary one.
+*/
+class PooledHttpClient {
+  public:
+    PooledHttpClient(const String &url);
+    ~PooledHttpClient();
+
+    void addHeader(const char * name, const char * value);
+    int sendRequest(const char * method, const char * payload);
+  private:
+    HttpConnectionPoolClass::Connection * _connection;
+    bool _keep = false;
+    WiFiClient _tmpClient;
+    HTTPClient _tmpHttp;
+
+    HTTPClient &http() {
+      return _connection != nullptr ? _connection->http : _tmpHttp;
+    }
+};
+
+#endif
+
+#endif
@@ -13,6 +13,8 @@
 #include "net/rest/handlers/DangerRequestHandler.h"
 #include "net/rest/handlers/SensorsRequestHandler.h"
 #include "net/rest/handlers/AssetsRequestHandler.h"
+#include "net/rest/handlers/EventsRequestHandler.h"
+#include "net/gateway/GatewayClient.h"
 
 const char * const _WEB_SERVER_TAG = "web_server";
 
@@ -87,6 +89,9 @@ void RestControllerClass::setupHandler() {
   #if ENABLE_CONFIG
     _server.addHandler(new ConfigRequestHandler());
   #endif
+  #if ENABLE_EVENTS
+    _server.addHandler(new EventsRequestHandler());
+  #endif
 
   _server.on("/health", HTTP_GET, [this](AsyncWebServerRequest * request) {
     request->send(200, "text/plain", "I am alive!!! :)");
@@ -101,6 +106,8 @@ void RestControllerClass::setupHandler() {
     doc["hooks"] = ENABLE_HOOKS == 1;
     doc["config"] = ENABLE_CONFIG == 1; 
     doc["logger"] = ENABLE_LOGGER == 1;
+    doc["events"] = ENABLE_EVENTS == 1;
+    doc["gatewayWs"] = ENABLE_GATEWAY_WS == 1;
     
     String response;
     serializeJson(doc, response);
@@ -133,6 +140,56 @@ void RestControllerClass::setupHandler() {
       #endif
     #endif
 
+    #if ENABLE_HOOKS
+      JsonObject hooksCheck = doc["timings"]["hooksCheck"].to<JsonObject>();
+      hooksCheck["last"] = HooksManager.getLastCheckTime();
+      hooksCheck["lastWatchers"] = HooksManager.getLastCheckWatchers();
+      hooksCheck["max"] = HooksManager.getMaxCheckTime();
+      hooksCheck["lastFired"] = HooksManager.getLastFiredCheckTime();
+      hooksCheck["lastFiredCalls"] = HooksManager.getLastFiredCheckCalls();
+
+      JsonObject dispatcher = doc["hooksDispatcher"].to<JsonObject>();
+      dispatcher["depth"] = HooksDispatcher.depth();
+      dispatcher["maxDepth"] = HooksDispatcher.maxDepth();
+      dispatcher["dropped"] = HooksDispatcher.dropped();
+      dispatcher["delivered"] = HooksDispatcher.delivered();
+
+      JsonObject httpPool = doc["httpPool"].to<JsonObject>();
+      httpPool["active"] = HttpConnectionPool.active();
+      httpPool["opened"] = HttpConnectionPool.opened();
+      httpPool["reused"] = HttpConnectionPool.reused();
+      httpPool["evicted"] = HttpConnectionPool.evicted();
+
+      #if ENABLE_NOTIFICATIONS_BATCHING
+        JsonObject batcher = doc["notificationsBatcher"].to<JsonObject>();
+        batcher["batches"] = NotificationsBatcher.batches();
+        batcher["notifications"] = NotificationsBatcher.notifications();
+        batcher["failedBatches"] = NotificationsBatcher.failedBatches();
+        batcher["dropped"] = NotificationsBatcher.dropped();
+      #endif
+    #endif
+
+    #if ENABLE_TEXT_SENSORS
+      JsonObject intern = doc["internTable"].to<JsonObject>();
+      intern["size"] = InternTable.size();
+      intern["full"] = InternTable.full();
+      intern["rejected"] = InternTable.rejected();
+    #endif
+
+    #if ENABLE_EVENTS
+      JsonObject events = doc["events"].to<JsonObject>();
+      events["clients"] = EventsStream.clients();
+      events["evicted"] = EventsStream.evicted();
+    #endif
+
+    #if ENABLE_GATEWAY_WS
+      JsonObject gateway = doc["gatewayWs"].to<JsonObject>();
+      gateway["connected"] = GatewayClient.connected();
+      gateway["connects"] = GatewayClient.connects();
+      gateway["commands"] = GatewayClient.commands();
+      gateway["messages"] = GatewayClient.messages();
+    #endif
+
     String response;
     serializeJson(doc, response);
     AsyncWebServerResponse * resp = request->beginResponse(200, CONTENT_TYPE_JSON, response);
@@ -53,6 +53,8 @@ class DangerRequestHandler : public AsyncWebHandler {
   };
  private:
   void restart() {
+    // don't lose changes waiting for delayed commit
+    SettingsRepository.commit();
     delay(1500);
     st_log_info(_DANGER_RQ_TAG, "---------RESTART---------");
     delay(500);
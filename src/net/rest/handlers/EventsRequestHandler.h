@@ -0,0 +1,69 @@
+#ifndef EVENTS_RQ_H
+#define EVENTS_RQ_H
+
+#include "Features.h"
+
+#if ENABLE_EVENTS
+
+#include <ESPAsyncWebServer.h>
+#include "logs/BetterLogger.h"
+#include "net/events/EventsStream.h"
+
+#define EVENTS_RQ_PATH "/events"
+
+const char * const _EVENTS_RQ_TAG = "events-handler";
+
+/*
+  Server-Sent Events stream, see EventsStream.
+  Response is chunked, its filler takes buffered events of subscriber.
+  When there are none, web server calls filler again on tcp poll (~500 ms).
+*/
+class EventsRequestHandler : public AsyncWebHandler {
+ public:
+  EventsRequestHandler(){};
+  virtual ~EventsRequestHandler() {};
+
+  bool canHandle(AsyncWebServerRequest *request) {
+    return request->url().equals(EVENTS_RQ_PATH) && request->method() == HTTP_GET;
+  };
+
+  void handleRequest(AsyncWebServerRequest *request) {
+    st_log_request(_EVENTS_RQ_TAG, request->methodToString(), request->url().c_str(), "");
+
+    // logs=<level> - send log lines of this level and above
+    uint8_t logLevel = EVENTS_LOGS_OFF;
+    if (request->hasArg("logs")) {
+      long level = request->arg("logs").toInt();
+      logLevel = level < LOGGING_LEVEL_DEBUG ? LOGGING_LEVEL_DEBUG : (level > LOGGING_LEVEL_ERROR ? LOGGING_LEVEL_ERROR : level);
+    }
+
+    EventsStreamClass::Client * client = EventsStream.subscribe(logLevel);
+    if (client == nullptr) {
+      st_log_warning(_EVENTS_RQ_TAG, "Too many events subscribers");
+      AsyncWebServerResponse * response = request->beginResponse(503, "text/plain", "Too many subscribers");
+      response->addHeader("Access-Control-Allow-Origin", "*");
+      request->send(response);
+      return;
+    }
+
+    AsyncWebServerResponse * response = request->beginChunkedResponse("text/event-stream",
+      [client](uint8_t * buffer, size_t maxLen, size_t index) -> size_t {
+        int length = EventsStream.take(client, buffer, maxLen);
+        if (length < 0) {
+          // evicted, finish response
+          return 0;
+        }
+        return length == 0 ? RESPONSE_TRY_AGAIN : length;
+      });
+    response->addHeader("Cache-Control", "no-cache");
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    // response (and its filler) is deleted together with request, client goes after it
+    request->onDisconnect([client]() {
+      EventsStream.unsubscribe(client);
+    });
+    request->send(response);
+  };
+};
+
+#endif
+#endif
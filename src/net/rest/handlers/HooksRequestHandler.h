@@ -93,7 +93,6 @@ class HooksRequestHandler : public RequestHandler {
           int id = HooksManager.add(sensor, doc["hook"].as<String>().c_str());
 
           if (id >= 0) {
-            HooksManager.saveInSettings();
             String response = "{\"id\":" + String(id) + "}";
             return request->beginResponse(201, CONTENT_TYPE_JSON, response);
           } else {
@@ -110,7 +109,6 @@ class HooksRequestHandler : public RequestHandler {
           JsonDocument doc;
           deserializeJson(doc, _body);
           if (HooksManager.update(doc)) {
-            HooksManager.saveInSettings();
             return request->beginResponse(200);
           } else {
             return request->beginResponse(500, CONTENT_TYPE_JSON,
@@ -128,7 +126,6 @@ class HooksRequestHandler : public RequestHandler {
           }
 
           if (HooksManager.remove(sensor.c_str(), id.toInt())) {
-            HooksManager.saveInSettings();
             return request->beginResponse(200);
           } else {
             return request->beginResponse(500, CONTENT_TYPE_JSON,
@@ -10,6 +10,19 @@
 #include "logs/BetterLogger.h"
 
 #define SENSORS_RQ_PATH "/sensors"
+// Snapshot cursor of returned values ("<boot id>:<version>"), version grows on every change
+#define SENSORS_SEQ_HEADER "X-Sensors-Seq"
+#define SENSORS_CHANGES_RQ_PATH "/sensors/changes"
+
+// Max time GET /sensors/changes waits for new values
+#ifndef SENSORS_CHANGES_MAX_TIMEOUT
+  #define SENSORS_CHANGES_MAX_TIMEOUT 30000 // ms
+#endif
+
+// Max time GET /sensors waits for loop task to sample sensors when nobody read them lately
+#ifndef SENSORS_SAMPLE_WAIT
+  #define SENSORS_SAMPLE_WAIT 2000 // ms
+#endif
 const char * const _SENSORS_RQ_TAG = "sensors-handler";
 
 class SensorsRequestHandler : public AsyncWebHandler {
@@ -46,14 +59,92 @@ class SensorsRequestHandler : public AsyncWebHandler {
     st_log_request(_SENSORS_RQ_TAG, request->methodToString(), request->url().c_str(), "");
 
     if (request->url().equals(SENSORS_RQ_PATH)) {
-      JsonDocument data = SensorsManager.getSensorsInfo();
-      String response;
-      serializeJson(data, response);
-      return request->beginResponse(200, "application/json", response);
+      // values published by loop task, so drivers are not called from web server task
+      AsyncWebServerResponse * asyncResponse = nullptr;
+      const SensorsSnapshot &snapshot = SensorsManager.getSnapshot();
+      if (SensorsManager.demandSamples()) {
+        JsonDocument data;
+        uint32_t seq = snapshot.toJson(data.to<JsonObject>());
+        String response;
+        serializeJson(data, response);
+        asyncResponse = request->beginResponse(200, "application/json", response);
+        asyncResponse->addHeader(SENSORS_SEQ_HEADER, snapshot.cursor(seq));
+      } else {
+        // sensors without hooks weren't sampled lately, web server calls filler again on tcp poll (~500 ms)
+        // until loop task samples them. Header goes first, so it gets current version: changes since it include sent values
+        uint32_t sampled = SensorsManager.sampledPublishes();
+        unsigned long started = millis();
+        String body;
+        asyncResponse = request->beginChunkedResponse("application/json",
+          [sampled, started, body](uint8_t * buffer, size_t maxLen, size_t index) mutable -> size_t {
+            if (body.isEmpty()) {
+              if (SensorsManager.sampledPublishes() == sampled && millis() - started < SENSORS_SAMPLE_WAIT) {
+                return RESPONSE_TRY_AGAIN;
+              }
+              JsonDocument data;
+              SensorsManager.getSnapshot().toJson(data.to<JsonObject>());
+              serializeJson(data, body);
+            }
+            return copyBody(body, buffer, maxLen, index);
+          });
+        asyncResponse->addHeader(SENSORS_SEQ_HEADER, snapshot.cursor(snapshot.version()));
+      }
+      asyncResponse->addHeader("Access-Control-Expose-Headers", SENSORS_SEQ_HEADER);
+      return asyncResponse;
+    }
+
+    if (request->url().equals(SENSORS_CHANGES_RQ_PATH)) {
+      // cursor of previous boot gives 0, so all values are sent right away
+      uint32_t since = SensorsManager.getSnapshot().since(request->arg("since").c_str());
+      unsigned long timeout = strtoul(request->arg("timeout").c_str(), nullptr, 10);
+      if (timeout > SENSORS_CHANGES_MAX_TIMEOUT) {
+        timeout = SENSORS_CHANGES_MAX_TIMEOUT;
+      }
+      SensorsManager.demandSamples();
+
+      if (timeout == 0 || SensorsManager.getSnapshot().version() != since) {
+        return request->beginResponse(200, "application/json", buildChanges(since));
+      }
+
+      // long poll: web server calls filler again on tcp poll (~500 ms) until it gives data
+      unsigned long started = millis();
+      String body;
+      return request->beginChunkedResponse("application/json",
+        [since, started, timeout, body](uint8_t * buffer, size_t maxLen, size_t index) mutable -> size_t {
+          if (body.isEmpty()) {
+            if (SensorsManager.getSnapshot().version() == since && millis() - started < timeout) {
+              // waiting client still reads values
+              SensorsManager.demandSamples();
+              return RESPONSE_TRY_AGAIN;
+            }
+            body = buildChanges(since);
+          }
+          return copyBody(body, buffer, maxLen, index);
+        });
     }
 
     return nullptr;
   }
+
+  // Copy next chunk of prepared body into response buffer
+  static size_t copyBody(const String &body, uint8_t * buffer, size_t maxLen, size_t index) {
+    size_t length = body.length() - index;
+    if (length > maxLen) {
+      length = maxLen;
+    }
+    memcpy(buffer, body.c_str() + index, length);
+    return length;
+  }
+
+  // {"seq": snapshot cursor, "sensors": {values changed since given version}}
+  static String buildChanges(uint32_t since) {
+    JsonDocument data;
+    const SensorsSnapshot &snapshot = SensorsManager.getSnapshot();
+    data["seq"] = snapshot.cursor(snapshot.toJson(data["sensors"].to<JsonObject>(), since));
+    String response;
+    serializeJson(data, response);
+    return response;
+  }
 };
 
 #endif
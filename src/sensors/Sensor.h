@@ -4,7 +4,11 @@
 #include "Features.h"
 
 #include <ArduinoJson.h>
-#include <functional>
+
+#include "utils/InlineFunction.h"
+#include "utils/InternTable.h"
+#include "utils/Lock.h"
+#include "utils/Registry.h"
 
 // todo move to sensor manager
 #ifndef NUMBER_SENSOR_DATA_TYPE
@@ -12,33 +16,220 @@
 #endif
 #define TEXT_SENSOR_DATA_TYPE String
 
+// Default sensor sampling interval for hooks
+#ifndef SMART_THING_HOOKS_CHECK_DELAY
+  #define SMART_THING_HOOKS_CHECK_DELAY 500 // ms
+#endif
+
+// How long sampled sensor value is reused, 0 - sensor's sampling interval
+#ifndef SENSOR_VALUE_MAX_AGE
+  #define SENSOR_VALUE_MAX_AGE 0 // ms
+#endif
+
+// Size of buffer given to BufferProvider of text sensor, including terminating zero
+#ifndef TEXT_SENSOR_BUFFER_SIZE
+  #define TEXT_SENSOR_BUFFER_SIZE 64
+#endif
+
+// Only text values have ids
+template <typename T>
+inline InternId internSensorValue(const T &value) {
+  return INTERN_NONE;
+}
+
+// Only text values can be written by BufferProvider
+template <typename T>
+inline void assignSensorValue(T &target, const char * buffer) {}
+
+#if ENABLE_TEXT_SENSORS
+// Values are only looked up, so table keeps hook triggers and is not filled by arbitrary sensor values
+inline InternId internSensorValue(const TEXT_SENSOR_DATA_TYPE &value) {
+  return InternTable.find(value);
+}
+
+// String keeps its capacity, so same sized values don't allocate
+inline void assignSensorValue(TEXT_SENSOR_DATA_TYPE &target, const char * buffer) {
+  target = buffer;
+}
+#endif
+
+enum SensorType {
+  UNKNOWN_SENSOR,
+  NUMBER_SENSOR,
+  TEXT_SENSOR
+};
+
+inline const char * sensorTypeToStr(SensorType type) {
+  switch (type) {
+    case NUMBER_SENSOR:
+      return "number";
+    case TEXT_SENSOR:
+      return "text";
+    default:
+      return "unknown";
+  }
+}
+
 const char * const _state = "state";
 const char * const _sensor = "sensor";
 
 template <typename T>
 class Sensor {
   public:
-    typedef std::function<T(void)> ValueProvider;
+    typedef InlineFunction<T(void)> ValueProvider;
+    /*
+      Text sensor provider which writes zero terminated value into buffer
+      instead of returning new String, so polling doesn't allocate.
+      Gets buffer and its size (TEXT_SENSOR_BUFFER_SIZE), returns value length.
+      Longer values are cut.
+    */
+    typedef InlineFunction<size_t(char * buffer, size_t size)> BufferProvider;
 
-    Sensor(const char * name, ValueProvider valueProvider): 
-      _valueProvider(valueProvider) {
-        _name = (char *) malloc(strlen(name) + 1);
-        strcpy(_name, name);
+    /*
+      @param name unique sensor system name
+      @param valueProvider lambda with logic for calculating sensor value.
+        If empty - sensor is push-only and its value is set through setValue
+      @param interval sampling interval in ms, 0 - SMART_THING_HOOKS_CHECK_DELAY
+    */
+    Sensor(const char * name, ValueProvider valueProvider, unsigned long interval = 0): 
+      _valueProvider(valueProvider),
+      _interval(interval == 0 ? SMART_THING_HOOKS_CHECK_DELAY : interval),
+      _maxAge(SENSOR_VALUE_MAX_AGE == 0 ? _interval : SENSOR_VALUE_MAX_AGE),
+      _value(),
+      _valueId(INTERN_NONE),
+      _sampledAt(0),
+      _sampled(false) {
+        _name = registryName(name);
+      };
+    /*
+      @param name unique sensor system name
+      @param bufferProvider lambda which writes sensor value into given buffer
+      @param interval sampling interval in ms, 0 - SMART_THING_HOOKS_CHECK_DELAY
+    */
+    Sensor(const char * name, BufferProvider bufferProvider, unsigned long interval = 0):
+      Sensor(name, ValueProvider(), interval) {
+        _bufferProvider = bufferProvider;
       };
     ~Sensor() {
-      free(_name);
+      freeRegistryName(_name);
     }
 
     const char * name() const {
       return _name;
     }
 
+    /*
+      Cached sensor value, shared by hooks and REST.
+      Provider is called only when cached sample is older than max age.
+    */
     T provideValue() const {
-      return _valueProvider();
+      LockGuard guard(_lock);
+      refresh();
+      return _value;
+    }
+
+    /*
+      Interned id of cached value (see InternTable), refreshed like provideValue,
+      but value itself is not copied.
+      INTERN_NONE for number sensors and values which are not hook triggers.
+    */
+    InternId provideValueId() const {
+      LockGuard guard(_lock);
+      refresh();
+      return _valueId;
+    }
+
+    /*
+      Call reader with cached value (refreshed like provideValue) without copying it.
+      Sensor is locked while reader runs, so keep it short.
+      @returns interned id of value, see provideValueId
+    */
+    template <typename F>
+    InternId readValue(F reader) const {
+      LockGuard guard(_lock);
+      refresh();
+      reader((const T &) _value);
+      return _valueId;
+    }
+
+    /*
+      Call reader with cached value without sampling sensor, see readValue
+      @returns false if sensor has no sample, reader isn't called then
+    */
+    template <typename F>
+    bool peekValue(F reader) const {
+      LockGuard guard(_lock);
+      if (!_sampled) {
+        return false;
+      }
+      reader((const T &) _value);
+      return true;
+    }
+
+    // Drop cached sample, so next provideValue calls provider
+    void invalidate() const {
+      LockGuard guard(_lock);
+      _sampled = false;
+    }
+
+    // Time (millis) when cached value was sampled or set
+    unsigned long sampledAt() const {
+      return _sampledAt;
+    }
+
+    unsigned long maxAge() const {
+      return _maxAge;
+    }
+
+    void setMaxAge(unsigned long maxAge) {
+      _maxAge = maxAge;
+    }
+
+    // Push-only sensors are not polled, their values come from SensorsManager.notify
+    bool isPush() const {
+      return !_valueProvider && !_bufferProvider;
+    }
+
+    void setValue(const T &value) {
+      LockGuard guard(_lock);
+      _value = value;
+      _valueId = internSensorValue(_value);
+      _sampledAt = millis();
+      _sampled = true;
+    }
+
+    unsigned long interval() const {
+      return _interval;
     }
   private:
-    char* _name;
+    const char * _name;
     ValueProvider _valueProvider;
+    BufferProvider _bufferProvider;
+    unsigned long _interval;
+    unsigned long _maxAge;
+    mutable T _value;
+    mutable InternId _valueId;
+    mutable unsigned long _sampledAt;
+    mutable bool _sampled;
+    mutable Lock _lock;
+
+    // Call provider if cached sample is too old, lock must be held
+    void refresh() const {
+      if (isPush() || (_sampled && millis() - _sampledAt < _maxAge)) {
+        return;
+      }
+      if (_bufferProvider) {
+        char buffer[TEXT_SENSOR_BUFFER_SIZE];
+        size_t length = _bufferProvider(buffer, TEXT_SENSOR_BUFFER_SIZE);
+        buffer[length < TEXT_SENSOR_BUFFER_SIZE ? length : TEXT_SENSOR_BUFFER_SIZE - 1] = 0;
+        assignSensorValue(_value, buffer);
+      } else {
+        _value = _valueProvider();
+      }
+      _valueId = internSensorValue(_value);
+      _sampledAt = millis();
+      _sampled = true;
+    }
 };
 
 #endif
\ No newline at end of file
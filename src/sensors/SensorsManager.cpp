@@ -5,51 +5,131 @@
 #include "sensors/SensorsManager.h"
 #include "logs/BetterLogger.h"
 
+#if ENABLE_HOOKS
+  #include "hooks/HooksManager.h"
+#endif
+#if ENABLE_EVENTS
+  #include "net/events/EventsStream.h"
+#endif
+
 SensorsManagerClass SensorsManager;
 
 #if ENABLE_TEXT_SENSORS
 template<>
-std::list<Sensor<TEXT_SENSOR_DATA_TYPE>*> * SensorsManagerClass::getList() {
-  return &_deviceStatesList;
+Registry<Sensor<TEXT_SENSOR_DATA_TYPE>, STATIC_REGISTRY_MAX_SENSORS> * SensorsManagerClass::getRegistry() {
+  return &_deviceStates;
 }
 #endif
 
 #if ENABLE_NUMBER_SENSORS
 template<>
-std::list<Sensor<NUMBER_SENSOR_DATA_TYPE>*> * SensorsManagerClass::getList() {
-  return &_sensorsList;
+Registry<Sensor<NUMBER_SENSOR_DATA_TYPE>, STATIC_REGISTRY_MAX_SENSORS> * SensorsManagerClass::getRegistry() {
+  return &_sensors;
 }
 
-bool SensorsManagerClass::addDigital(const char* name, uint8_t pin, uint8_t mode) {
+bool SensorsManagerClass::addDigital(const char* name, uint8_t pin, uint8_t mode, unsigned long interval) {
   pinMode(pin, mode);
   return add<NUMBER_SENSOR_DATA_TYPE>(name, [pin]() {
     if (pin > 0) {
       return digitalRead(pin);
     }
     return -1;
-  });
+  }, interval);
 }
 
-bool SensorsManagerClass::addAnalog(const char* name, uint8_t pin) {
+bool SensorsManagerClass::addAnalog(const char* name, uint8_t pin, unsigned long interval) {
   return add<NUMBER_SENSOR_DATA_TYPE>(name, [pin]() {
     if (pin > 0) {
       return (int)analogRead(pin);
     }
     return -1;
-  });
+  }, interval);
+}
+
+#endif
+
+template<typename T>
+bool SensorsManagerClass::notifySensor(const char * name, const T &value) {
+  Sensor<T> * sensor = getRegistry<T>()->find(name);
+  if (sensor == nullptr) {
+    st_log_error(_SENSORS_MANAGER_TAG, "Can't find sensor %s", name);
+    return false;
+  }
+  if (!sensor->isPush()) {
+    st_log_error(_SENSORS_MANAGER_TAG, "Sensor %s is not push sensor", name);
+    return false;
+  }
+
+  sensor->setValue(value);
+  #if ENABLE_HOOKS
+    HooksManager.check(name);
+  #endif
+  return true;
+}
+
+#if ENABLE_NUMBER_SENSORS
+bool SensorsManagerClass::notify(const char * name, NUMBER_SENSOR_DATA_TYPE value) {
+  return notifySensor<NUMBER_SENSOR_DATA_TYPE>(name, value);
 }
+#endif
 
+#if ENABLE_TEXT_SENSORS
+bool SensorsManagerClass::notify(const char * name, TEXT_SENSOR_DATA_TYPE value) {
+  return notifySensor<TEXT_SENSOR_DATA_TYPE>(name, value);
+}
 #endif
 
+bool SensorsManagerClass::notify(const char * name) {
+  switch (getSensorType(name)) {
+    #if ENABLE_NUMBER_SENSORS
+      case NUMBER_SENSOR:
+        // cached sample is outdated now
+        _sensors.find(name)->invalidate();
+        break;
+    #endif
+    #if ENABLE_TEXT_SENSORS
+      case TEXT_SENSOR:
+        _deviceStates.find(name)->invalidate();
+        break;
+    #endif
+    default:
+      st_log_error(_SENSORS_MANAGER_TAG, "Can't find sensor %s", name);
+      return false;
+  }
+  #if ENABLE_HOOKS
+    HooksManager.check(name);
+  #endif
+  return true;
+}
+
+bool SensorsManagerClass::setMaxAge(const char * name, unsigned long maxAge) {
+  #if ENABLE_NUMBER_SENSORS
+    Sensor<NUMBER_SENSOR_DATA_TYPE> * sensor = _sensors.find(name);
+    if (sensor != nullptr) {
+      sensor->setMaxAge(maxAge);
+      return true;
+    }
+  #endif
+  #if ENABLE_TEXT_SENSORS
+    Sensor<TEXT_SENSOR_DATA_TYPE> * state = _deviceStates.find(name);
+    if (state != nullptr) {
+      state->setMaxAge(maxAge);
+      return true;
+    }
+  #endif
+  st_log_error(_SENSORS_MANAGER_TAG, "Can't find sensor %s", name);
+  return false;
+}
+
 size_t SensorsManagerClass::count() {
   size_t result = 0;
   
   #if ENABLE_NUMBER_SENSORS
-    result += getList<NUMBER_SENSOR_DATA_TYPE>()->size();
+    result += getRegistry<NUMBER_SENSOR_DATA_TYPE>()->size();
   #endif
   
   #if ENABLE_TEXT_SENSORS
-    result += getList<TEXT_SENSOR_DATA_TYPE>()->size();
+    result += getRegistry<TEXT_SENSOR_DATA_TYPE>()->size();
   #endif
 
   return result;
@@ -63,18 +143,114 @@ JsonDocument SensorsManagerClass::getSensorsInfo() {
   JsonObject object = doc.as<JsonObject>();
 
   #if ENABLE_NUMBER_SENSORS
-    for (auto it = _sensorsList.begin(); it != _sensorsList.end(); ++it) {
+    for (auto it = _sensors.begin(); it != _sensors.end(); ++it) {
       object[(*it)->name()] = (*it)->provideValue();
     }
   #endif
 
   #if ENABLE_TEXT_SENSORS
-    for (auto it = _deviceStatesList.begin(); it != _deviceStatesList.end(); ++it) {
-      object[(*it)->name()] = (*it)->provideValue();
+    for (auto it = _deviceStates.begin(); it != _deviceStates.end(); ++it) {
+      const char * name = (*it)->name();
+      (*it)->readValue([&object, name](const TEXT_SENSOR_DATA_TYPE &value) {
+        object[name] = value;
+      });
     }
   #endif
 
   return doc;
 }
 
+bool SensorsManagerClass::demandSamples() {
+  bool active = sampling();
+  _demandAt = millis();
+  _demanded = true;
+  return active;
+}
+
+bool SensorsManagerClass::sampling() const {
+  #if ENABLE_EVENTS
+    // events and gateway clients get every change
+    if (EventsStream.hasClients()) {
+      return true;
+    }
+  #endif
+  return _demanded && millis() - _demandAt < SENSORS_SAMPLE_DEMAND_TIMEOUT;
+}
+
+bool SensorsManagerClass::publishSnapshot() {
+  // without readers providers are called only by hooks on sensors own schedule
+  bool sample = sampling();
+  size_t count = this->count();
+  size_t currentCount = 0;
+  const SensorsSnapshot::Value * current = _snapshot.current(currentCount);
+  bool changed = currentCount != count;
+  // version which is published if some value changed
+  uint32_t next = _snapshot.version() + 1;
+
+  SensorsSnapshot::Value * values = _snapshot.beginWrite(count);
+  size_t i = 0;
+
+  #if ENABLE_NUMBER_SENSORS
+    for (Sensor<NUMBER_SENSOR_DATA_TYPE> * sensor : _sensors) {
+      SensorsSnapshot::Value &value = values[i];
+      value.name = sensor->name();
+      value.type = NUMBER_SENSOR;
+      // sensor without sample is sampled once, so snapshot never has made up value
+      if (sample || !sensor->peekValue([&value](const NUMBER_SENSOR_DATA_TYPE &number) { value.number = number; })) {
+        value.number = sensor->provideValue();
+      }
+      bool differs = i >= currentCount || current[i].name != value.name || value.number != current[i].number;
+      value.changed = differs ? next : current[i].changed;
+      changed = changed || differs;
+      i++;
+    }
+  #endif
+
+  #if ENABLE_TEXT_SENSORS
+    for (Sensor<TEXT_SENSOR_DATA_TYPE> * sensor : _deviceStates) {
+      SensorsSnapshot::Value &value = values[i];
+      value.name = sensor->name();
+      value.type = TEXT_SENSOR;
+      auto write = [this, &value](const TEXT_SENSOR_DATA_TYPE &text) {
+        _snapshot.setText(value, text.c_str(), text.length());
+      };
+      if (sample || !sensor->peekValue(write)) {
+        sensor->readValue(write);
+      }
+      // new number sensors shift text ones, so names are compared too
+      bool differs = i >= currentCount || current[i].name != value.name || value.textLength != current[i].textLength ||
+        memcmp(_snapshot.text(value), _snapshot.text(current[i]), value.textLength) != 0;
+      value.changed = differs ? next : current[i].changed;
+      changed = changed || differs;
+      i++;
+    }
+  #endif
+
+  bool published = _snapshot.endWrite(changed);
+  if (sample) {
+    _sampledPublishes = _sampledPublishes + 1;
+  }
+  if (!published) {
+    return false;
+  }
+
+  #if ENABLE_EVENTS
+    if (EventsStream.hasClients()) {
+      String seq = _snapshot.cursor(next);
+      for (size_t j = 0; j < count; j++) {
+        const SensorsSnapshot::Value &value = values[j];
+        if (value.changed != next) {
+          continue;
+        }
+        if (value.type == NUMBER_SENSOR) {
+          EventsStream.sensorChanged(value.name, value.number, seq);
+        } else {
+          EventsStream.sensorChanged(value.name, _snapshot.text(value), seq);
+        }
+      }
+    }
+  #endif
+  return true;
+}
+
 #endif
\ No newline at end of file
@@ -3,32 +3,21 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <list>
 
 #include "Features.h"
 #include "sensors/Sensor.h"
+#include "sensors/SensorsSnapshot.h"
 #include "logs/BetterLogger.h"
+#include "utils/Registry.h"
 
 #if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
 
 const char * const _SENSORS_MANAGER_TAG = "sensors-manager";
 
-enum SensorType {
-  UNKNOWN_SENSOR,
-  NUMBER_SENSOR,
-  TEXT_SENSOR
-};
-
-inline const char * sensorTypeToStr(SensorType type) {
-  switch (type) {
-    case NUMBER_SENSOR:
-      return "number";
-    case TEXT_SENSOR:
-      return "text";
-    default:
-      return "unknown";
-  }
-}
+// Sensors without hooks are sampled for snapshot only for this time after last read of values (ms)
+#ifndef SENSORS_SAMPLE_DEMAND_TIMEOUT
+  #define SENSORS_SAMPLE_DEMAND_TIMEOUT 30000
+#endif
 
 class SensorsManagerClass {
   public:
@@ -37,10 +26,11 @@ class SensorsManagerClass {
         Add number sensor
         @param name unique sensor system name
         @param valueProvider lambda with logic for calculating sensor value
+        @param interval sampling interval in ms (0 - default SMART_THING_HOOKS_CHECK_DELAY)
         @return true if sensor added
       */
-      bool add(const char * name, typename Sensor<NUMBER_SENSOR_DATA_TYPE>::ValueProvider valueProvider) {
-        return add<NUMBER_SENSOR_DATA_TYPE>(name, valueProvider);
+      bool add(const char * name, typename Sensor<NUMBER_SENSOR_DATA_TYPE>::ValueProvider valueProvider, unsigned long interval = 0) {
+        return add<NUMBER_SENSOR_DATA_TYPE>(name, valueProvider, interval);
       }
 
       /*
@@ -48,49 +38,140 @@ class SensorsManagerClass {
         @param name unique sensor system name
         @param pin digital sensor pin
         @param mode pin mode
+        @param interval sampling interval in ms (0 - default)
         @returns true if sensor added
       */
-      bool addDigital(const char* name, uint8_t pin, uint8_t mode = INPUT_PULLUP);
+      bool addDigital(const char* name, uint8_t pin, uint8_t mode = INPUT_PULLUP, unsigned long interval = 0);
       /*
         Add analog sensor (uses analogRead)
         @param name unique sensor system name
         @param pin analog sensor pin
+        @param interval sampling interval in ms (0 - default)
+        @returns true if sensor added
+      */
+      bool addAnalog(const char* name, uint8_t pin, unsigned long interval = 0);
+      /*
+        Add push-only number sensor. It is never polled, values are
+        reported by firmware through notify(name, value)
+        @param name unique sensor system name
+        @param initialValue sensor value until first notify
         @returns true if sensor added
       */
-      bool addAnalog(const char* name, uint8_t pin);
+      bool addPush(const char * name, NUMBER_SENSOR_DATA_TYPE initialValue) {
+        return addPushSensor<NUMBER_SENSOR_DATA_TYPE>(name, initialValue);
+      }
+      /*
+        Report new value of push-only number sensor.
+        Sensor hooks are evaluated right away in caller's context,
+        so don't call it from ISR - defer call to a task instead.
+        @param name sensor system name
+        @param value new sensor value
+        @returns true if sensor found
+      */
+      bool notify(const char * name, NUMBER_SENSOR_DATA_TYPE value);
     #endif
     #if ENABLE_TEXT_SENSORS
       /*
         Add text sensor
         @param name unique unique sensor system name
         @param valueProvider lambda with logic for calculating sensor value
+        @param interval sampling interval in ms (0 - default SMART_THING_HOOKS_CHECK_DELAY)
+        @return true if sensor added
+      */
+      bool add(const char * name, typename Sensor<TEXT_SENSOR_DATA_TYPE>::ValueProvider valueProvider, unsigned long interval = 0) {
+        return add<TEXT_SENSOR_DATA_TYPE>(name, valueProvider, interval);
+      }
+      /*
+        Add text sensor which writes its value into buffer, so sampling doesn't allocate
+        @param name unique sensor system name
+        @param bufferProvider lambda which writes value into buffer and returns its length
+        @param interval sampling interval in ms (0 - default SMART_THING_HOOKS_CHECK_DELAY)
         @return true if sensor added
       */
-      bool add(const char * name, typename Sensor<TEXT_SENSOR_DATA_TYPE>::ValueProvider valueProvider) {
-        return add<TEXT_SENSOR_DATA_TYPE>(name, valueProvider);
+      bool add(const char * name, typename Sensor<TEXT_SENSOR_DATA_TYPE>::BufferProvider bufferProvider, unsigned long interval = 0) {
+        return add<TEXT_SENSOR_DATA_TYPE>(name, bufferProvider, interval);
+      }
+      /*
+        Add push-only text sensor. It is never polled, values are
+        reported by firmware through notify(name, value)
+        @param name unique sensor system name
+        @param initialValue sensor value until first notify
+        @returns true if sensor added
+      */
+      bool addPush(const char * name, TEXT_SENSOR_DATA_TYPE initialValue) {
+        return addPushSensor<TEXT_SENSOR_DATA_TYPE>(name, initialValue);
       }
+      /*
+        Report new value of push-only text sensor.
+        Sensor hooks are evaluated right away in caller's context,
+        so don't call it from ISR - defer call to a task instead.
+        @param name sensor system name
+        @param value new sensor value
+        @returns true if sensor found
+      */
+      bool notify(const char * name, TEXT_SENSOR_DATA_TYPE value);
     #endif
 
+    /*
+      Tell that sensor value changed, so its hooks are evaluated
+      right away instead of waiting for next check
+      @param name sensor system name
+      @returns true if sensor found
+    */
+    bool notify(const char * name);
+
+    /*
+      Set how long sampled value is reused by hooks and REST
+      @param name sensor system name
+      @param maxAge max age of cached value in ms
+      @returns true if sensor found
+    */
+    bool setMaxAge(const char * name, unsigned long maxAge);
+
     size_t count();
     JsonDocument getSensorsInfo();
 
+    /*
+      Publish sensors values to snapshot if some value changed. Loop task only.
+      While somebody reads values (see demandSamples, events clients) sensors are sampled
+      (cached values are reused), otherwise only cached samples (taken by hooks) are published.
+      @returns true if new snapshot version was published
+    */
+    bool publishSnapshot();
+
+    /*
+      Tell that somebody reads values, so publishSnapshot samples sensors
+      for next SENSORS_SAMPLE_DEMAND_TIMEOUT ms. Can be called from any task.
+      @returns true if sensors were already sampled, so snapshot values are fresh
+    */
+    bool demandSamples();
+
+    // @returns true if publishSnapshot samples sensors
+    bool sampling() const;
+
+    // Count of publishSnapshot calls which sampled sensors, can be read from any task
+    uint32_t sampledPublishes() const {
+      return _sampledPublishes;
+    }
+
+    // Values published by publishSnapshot, can be read from any task
+    const SensorsSnapshot &getSnapshot() const {
+      return _snapshot;
+    }
+
     template<typename T>
     const Sensor<T> * getSensor(const char * name) {
-      auto it = getSensorIterator<T>(name);
-      if (it == getList<T>()->end()) {
-        return nullptr;
-      }
-      return *it;
+      return getRegistry<T>()->find(name);
     }
     
     SensorType getSensorType(const char * name) {
       #if ENABLE_NUMBER_SENSORS
-        if (getSensorIterator<NUMBER_SENSOR_DATA_TYPE>(name) != _sensorsList.end()) {
+        if (_sensors.contains(name)) {
           return NUMBER_SENSOR;
         }
       #endif
       #if ENABLE_TEXT_SENSORS
-        if (getSensorIterator<TEXT_SENSOR_DATA_TYPE>(name) != _deviceStatesList.end()) {
+        if (_deviceStates.contains(name)) {
           return TEXT_SENSOR;
         }
       #endif
@@ -98,52 +179,56 @@ class SensorsManagerClass {
     }
   private:
     #if ENABLE_NUMBER_SENSORS
-      std::list<Sensor<NUMBER_SENSOR_DATA_TYPE>*> _sensorsList;
+      Registry<Sensor<NUMBER_SENSOR_DATA_TYPE>, STATIC_REGISTRY_MAX_SENSORS> _sensors;
     #endif
 
     #if ENABLE_TEXT_SENSORS
-      std::list<Sensor<TEXT_SENSOR_DATA_TYPE>*> _deviceStatesList;
+      Registry<Sensor<TEXT_SENSOR_DATA_TYPE>, STATIC_REGISTRY_MAX_SENSORS> _deviceStates;
     #endif
 
-    template<typename T>
+    SensorsSnapshot _snapshot;
+    RcuCounter _demandAt{0};
+    volatile bool _demanded = false;
+    RcuCounter _sampledPublishes{0};
+
+    template<typename T, typename Provider>
     bool add(
       const char* name,
-      typename Sensor<T>::ValueProvider valueProvider
+      Provider provider,
+      unsigned long interval = 0
     )  {
-      bool exists = false;
-      #if ENABLE_NUMBER_SENSORS
-        exists = getSensorIterator<NUMBER_SENSOR_DATA_TYPE>(name) != _sensorsList.end();
-      #endif
-
-      #if ENABLE_TEXT_SENSORS
-        exists = exists || getSensorIterator<TEXT_SENSOR_DATA_TYPE>(name) != _deviceStatesList.end();
-      #endif
+      if (name == nullptr || strlen(name) == 0) {
+        st_log_error(_SENSORS_MANAGER_TAG, "Sensor name is missing!");
+        return false;
+      }
 
-      if (exists) {
+      if (getSensorType(name) != UNKNOWN_SENSOR) {
         st_log_warning(_SENSORS_MANAGER_TAG, "Sensor with name %s already exist! Skipping...", name);
         return false;
       }
 
-      getList<T>()->push_back(new Sensor<T>(name, valueProvider));
+      if (getRegistry<T>()->add(name, provider, interval) == nullptr) {
+        st_log_error(_SENSORS_MANAGER_TAG, "Failed to add sensor %s, registry is full", name);
+        return false;
+      }
       st_log_debug(_SENSORS_MANAGER_TAG, "Added new device sensor %s", name);
       return true;
     }
 
     template<typename T>
-    std::list<Sensor<T>*> * getList();
-
-    template<typename T>
-    typename std::list<Sensor<T>*>::iterator getSensorIterator(const char * name) {
-      auto list = getList<T>();
-      if (name == nullptr || strlen(name) == 0) {
-        return list->end();
+    bool addPushSensor(const char * name, const T &initialValue) {
+      if (!add<T>(name, typename Sensor<T>::ValueProvider())) {
+        return false;
       }
-
-      return std::find_if(list->begin(), list->end(), [name](const Sensor<T> * sensor) {
-          return strcmp(sensor->name(), name) == 0;
-      });
+      getRegistry<T>()->find(name)->setValue(initialValue);
+      return true;
     }
 
+    template<typename T>
+    bool notifySensor(const char * name, const T &value);
+
+    template<typename T>
+    Registry<Sensor<T>, STATIC_REGISTRY_MAX_SENSORS> * getRegistry();
   };
 
 extern SensorsManagerClass SensorsManager;
@@ -0,0 +1,199 @@
+#include "Features.h"
+
+#if defined(ENABLE_NUMBER_SENSORS) && ENABLE_NUMBER_SENSORS || ENABLE_TEXT_SENSORS
+
+#include "sensors/SensorsSnapshot.h"
+
+// Orders values access against sequence counters
+static inline void snapshotFence() {
+  #ifdef ARDUINO_ARCH_ESP32
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  #endif
+}
+
+SensorsSnapshot::Table::Table(size_t capacity): capacity(capacity), current(0) {
+  for (uint8_t i = 0; i < 2; i++) {
+    buffers[i].seq = 0;
+    buffers[i].version = 0;
+    buffers[i].count = 0;
+    buffers[i].values = new Value[capacity]();
+    buffers[i].text.publish(new Text(capacity * SENSORS_SNAPSHOT_TEXT_SIZE + 1));
+    buffers[i].textSize = 0;
+  }
+}
+
+SensorsSnapshot::Table::~Table() {
+  for (uint8_t i = 0; i < 2; i++) {
+    delete[] buffers[i].values;
+    delete buffers[i].text.load();
+  }
+}
+
+SensorsSnapshot::~SensorsSnapshot() {
+  delete _pending;
+  delete _table.load();
+}
+
+SensorsSnapshot::Value * SensorsSnapshot::beginWrite(size_t count) {
+  Table * table = _table.load();
+  if (table == nullptr || table->capacity < count) {
+    // readers keep using current table until endWrite publishes new one
+    delete _pending;
+    _pending = new Table(count);
+    table = _pending;
+  }
+
+  Buffer &next = table->buffers[(table->current + 1) & 1];
+  next.seq = next.seq + 1;
+  snapshotFence();
+  next.count = count;
+  next.textSize = 0;
+  _writing = &next;
+  return next.values;
+}
+
+void SensorsSnapshot::setText(Value &value, const char * text, size_t length) {
+  Buffer &buffer = *_writing;
+  Text * arena = buffer.text.load();
+  size_t size = buffer.textSize + length + 1;
+  if (size > arena->capacity) {
+    // offsets stay the same, so values written before are kept as they are
+    Text * grown = new Text(size > arena->capacity * 2 ? size : arena->capacity * 2);
+    memcpy(grown->data, arena->data, buffer.textSize);
+    buffer.text.publish(grown);
+    // reader can still copy old arena
+    _rcu.retire(arena);
+    arena = grown;
+  }
+  memcpy(arena->data + buffer.textSize, text, length);
+  arena->data[buffer.textSize + length] = 0;
+  value.textOffset = buffer.textSize;
+  value.textLength = length;
+  buffer.textSize = size;
+}
+
+const char * SensorsSnapshot::text(const Value &value) const {
+  const Table * tables[] = {_pending, _table.load()};
+  for (const Table * table : tables) {
+    if (table == nullptr) {
+      continue;
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+      const Buffer &buffer = table->buffers[i];
+      if (&value >= buffer.values && &value < buffer.values + table->capacity) {
+        return buffer.text.load()->data + value.textOffset;
+      }
+    }
+  }
+  return "";
+}
+
+const SensorsSnapshot::Value * SensorsSnapshot::current(size_t &count) const {
+  const Table * table = _table.load();
+  if (table == nullptr) {
+    count = 0;
+    return nullptr;
+  }
+  const Buffer &buffer = table->buffers[table->current & 1];
+  count = buffer.count;
+  return buffer.values;
+}
+
+bool SensorsSnapshot::endWrite(bool changed) {
+  Table * table = _pending != nullptr ? _pending : _table.load();
+  uint8_t index = (table->current + 1) & 1;
+  Buffer &next = table->buffers[index];
+  if (_pending != nullptr) {
+    changed = true;
+  }
+
+  // unchanged values are the same as in current version
+  uint32_t version = _version;
+  next.version = changed ? version + 1 : version;
+  snapshotFence();
+  next.seq = next.seq + 1;
+  if (changed) {
+    table->current = index;
+    _version = next.version;
+  }
+
+  if (_pending != nullptr) {
+    Table * old = _table.load();
+    _table.publish(_pending);
+    _pending = nullptr;
+    _rcu.retire(old);
+  }
+  _writing = nullptr;
+  _rcu.reclaim();
+  return changed;
+}
+
+String SensorsSnapshot::cursor(uint32_t version) const {
+  char buff[24];
+  sprintf(buff, "%lx:%lu", (unsigned long) _boot, (unsigned long) version);
+  return buff;
+}
+
+uint32_t SensorsSnapshot::since(const char * cursor) const {
+  char * end;
+  uint32_t boot = strtoul(cursor, &end, 16);
+  if (boot != _boot || *end != ':') {
+    return 0;
+  }
+  return strtoul(end + 1, nullptr, 10);
+}
+
+uint32_t SensorsSnapshot::toJson(JsonObject object, uint32_t since) const {
+  RcuReadGuard guard(_rcu);
+  const Table * table = _table.load();
+  if (table == nullptr) {
+    return 0;
+  }
+
+  Value value;
+  while (true) {
+    // active buffer is never written, so this retries only if writer got to it again
+    const Buffer &buffer = table->buffers[table->current & 1];
+    uint32_t seq = buffer.seq;
+    if (seq & 1) {
+      continue;
+    }
+    snapshotFence();
+    uint32_t version = buffer.version;
+    size_t count = buffer.count;
+    uint32_t from = since > version ? 0 : since;
+
+    // arena is replaced only while buffer is written, torn check below covers this read too
+    const Text * text = buffer.text.load();
+
+    bool torn = false;
+    for (size_t i = 0; i < count && !torn; i++) {
+      // unchanged values are skipped without copying, torn check below covers this read too
+      if (buffer.values[i].changed <= from) {
+        continue;
+      }
+      memcpy(&value, &buffer.values[i], sizeof(Value));
+      snapshotFence();
+      // copy can be used only if writer didn't touch buffer meanwhile
+      if (buffer.seq != seq) {
+        torn = true;
+        break;
+      }
+      if (value.type == NUMBER_SENSOR) {
+        object[value.name] = value.number;
+      } else if (value.textOffset + value.textLength < text->capacity) {
+        // json copies text, if writer changes it meanwhile, torn check below drops the copy
+        object[value.name] = JsonString(text->data + value.textOffset, value.textLength);
+      } else {
+        torn = true;
+      }
+    }
+    snapshotFence();
+    if (!torn && buffer.seq == seq) {
+      return version;
+    }
+    object.clear();
+  }
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef SENSORS_SNAPSHOT_H
+#define SENSORS_SNAPSHOT_H
+
+#include "Features.h"
+
+#include <ArduinoJson.h>
+
+#include "sensors/Sensor.h"
+#include "utils/Rcu.h"
+
+// Text space reserved per sensor in snapshot buffer, it grows when values don't fit
+#ifndef SENSORS_SNAPSHOT_TEXT_SIZE
+  #define SENSORS_SNAPSHOT_TEXT_SIZE TEXT_SENSOR_BUFFER_SIZE
+#endif
+
+/*
+  Values of all sensors published by loop task for readers from other tasks (REST).
+  Readers don't take locks and don't call sensor providers.
+
+  Values are kept in two buffers, each one guarded by its own sequence counter (seqlock).
+  Writer fills inactive buffer (counter is odd while it writes) and then makes it active,
+  reader copies active buffer and retries if its counter changed meanwhile.
+  So reader retries only when writer got through two publishes while it was copying.
+  Buffers are reallocated (and old ones retired through RCU) only when sensors count grows.
+  Text values are kept whole in text arena of their buffer, value has only offset and length.
+  Arena is reallocated (and old one retired) when values don't fit it.
+*/
+class SensorsSnapshot {
+  public:
+    struct Value {
+      const char * name;
+      SensorType type;
+      // version in which value was changed last time
+      uint32_t changed;
+      NUMBER_SENSOR_DATA_TYPE number;
+      // zero terminated text value in buffer text arena
+      size_t textOffset;
+      size_t textLength;
+    };
+
+    SensorsSnapshot(): _version(0), _boot(random(1, 0x7FFFFFFF)) {};
+    ~SensorsSnapshot();
+
+    /*
+      Start writing next version, writer only
+      @param count sensors count
+      @returns count values to fill
+    */
+    Value * beginWrite(size_t count);
+
+    /*
+      Put text value of value returned by beginWrite, writer only
+      @param length text length without terminating zero
+    */
+    void setText(Value &value, const char * text, size_t length);
+
+    // Text value of value returned by beginWrite or current, writer only
+    const char * text(const Value &value) const;
+
+    /*
+      Values of current version, writer only
+      @param count values count
+      @returns nullptr if nothing was published yet
+    */
+    const Value * current(size_t &count) const;
+
+    /*
+      Finish writing started by beginWrite, writer only
+      @param changed true if values differ from current ones, otherwise version isn't changed
+      @returns true if new version was published
+    */
+    bool endWrite(bool changed);
+
+    /*
+      Put consistent copy of values in json object (sensor name - value)
+      @param since version reader already has (see since()), only values changed after it are copied.
+        All values are copied if it's newer than snapshot version
+      @returns version of copied values, 0 if nothing was published yet
+    */
+    uint32_t toJson(JsonObject object, uint32_t since = 0) const;
+
+    uint32_t version() const {
+      return _version;
+    }
+
+    /*
+      Cursor given to readers instead of bare version: "<boot id>:<version>".
+      Boot id is random on every boot, so version of previous boot is never taken for current one.
+    */
+    String cursor(uint32_t version) const;
+
+    // @returns version of cursor given on this boot, 0 (all values) for cursor of another boot or bad one
+    uint32_t since(const char * cursor) const;
+
+  private:
+    struct Text {
+      size_t capacity;
+      char * data;
+
+      Text(size_t capacity): capacity(capacity), data(new char[capacity]) {};
+      ~Text() {
+        delete[] data;
+      }
+    };
+
+    struct Buffer {
+      RcuCounter seq;
+      uint32_t version;
+      size_t count;
+      Value * values;
+      RcuPointer<Text> text;
+      // used part of text arena, writer only
+      size_t textSize;
+    };
+
+    struct Table {
+      size_t capacity;
+      Buffer buffers[2];
+      // index of active buffer
+      RcuCounter current;
+
+      Table(size_t capacity);
+      ~Table();
+    };
+
+    RcuPointer<Table> _table;
+    // new table which is published by endWrite
+    Table * _pending = nullptr;
+    // buffer written between beginWrite and endWrite
+    Buffer * _writing = nullptr;
+    RcuCounter _version;
+    const uint32_t _boot;
+    mutable RcuDomain _rcu;
+};
+
+#endif
@@ -2,27 +2,101 @@
 #include "SmartThing.h"
 
 #include <EEPROM.h>
+#include <vector>
+#if SETTINGS_NVS
+  #include <Preferences.h>
+#endif
 
-#define EEPROM_LOAD_SIZE 1024
-
-// [offsets][name][wifi][config][hooks][actions]
-#define SETTINGS_TEMPLATE "%03d%03d%03d%03d%03d%s%s%s%s%s"
+/*
+  Storage layout:
+  [magic 2][version 1][sections count 1][sequence 4][varint length and crc32 of each section][header crc32 4][sections data]
+  Header crc32 covers everything before it. Every section has own crc32,
+  so a damaged section (torn write) is dropped alone and the others are kept.
+  Sections order: wifi, name, config, hooks, actions
+
+  On esp8266 there are two copies of storage: A in EEPROM sector and B in backup one.
+  Commit writes the older copy with the next sequence number, so the current copy
+  survives power loss during write. Load takes the newest copy with valid header
+  and damaged sections of it are taken from the other copy.
+*/
+#define SETTINGS_MAGIC_0 'S'
+#define SETTINGS_MAGIC_1 'T'
+#define SETTINGS_VERSION 3
+// Previous layout with one crc32 of header and all sections: [magic 2][version 1][sections count 1][varint length of each section][crc32 4][sections data]
+#define SETTINGS_VERSION_V2 2
+// magic, version, count, sequence, 3 bytes varint (up to 2^21) and crc per section, header crc
+#define SETTINGS_HEADER_MAX_SIZE (8 + 7 * SETTINGS_SECTIONS_COUNT + 4)
+
+// Legacy text layout: [%03d length of each section][sections data], 1024 bytes
+#define LEGACY_STORAGE_SIZE 1024
 #define LENGTH_PARTITION_SIZE 3
 #define DATA_OFFSET 15
 
+/*
+  Dump (export/import) prefix of current text format
+  Sections data is escaped: \\, \n, \t and \xHH for other non printable bytes
+*/
+#define DUMP_PREFIX "ST3"
+// Previous dump format, only \n and \t were escaped
+#define DUMP_PREFIX_V2 "ST2"
+
+#if SETTINGS_NVS
+  #define SETTINGS_NVS_NAMESPACE "st_settings"
+  // present when settings were moved from EEPROM to NVS
+  #define SETTINGS_NVS_VERSION_KEY "ver"
+
+  static Preferences preferences;
+  // NVS keys of sections, same order as DataIndex
+  static const char * const _sectionKeys[SETTINGS_SECTIONS_COUNT] = {"wifi", "name", "config", "hooks", "actions"};
+#endif
+
 #ifdef ARDUINO_ARCH_ESP32
-bool eepromBegin() {
-  return EEPROM.begin(EEPROM_LOAD_SIZE);
+bool eepromBegin(EEPROMClass &eeprom) {
+  return eeprom.begin(SETTINGS_STORAGE_SIZE);
 }
 #endif
 
 #ifdef ARDUINO_ARCH_ESP8266
-bool eepromBegin() {
-  EEPROM.begin(EEPROM_LOAD_SIZE);
+#include <flash_hal.h>
+
+extern "C" uint32_t _EEPROM_start;
+
+bool eepromBegin(EEPROMClass &eeprom) {
+  eeprom.begin(SETTINGS_STORAGE_SIZE);
   return true;
 }
+
+// @returns 0 if there is no free sector for backup copy
+static uint32_t backupSector() {
+  #if SETTINGS_BACKUP_SECTOR
+    return SETTINGS_BACKUP_SECTOR;
+  #else
+    uint32_t eepromSector = ((uint32_t) &_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE;
+    // file system ends at EEPROM or one sector before it, depending on flash layout
+    if ((uint32_t) &_FS_end - 0x40200000 > (eepromSector - 1) * SPI_FLASH_SEC_SIZE) {
+      return 0;
+    }
+    return eepromSector - 1;
+  #endif
+}
 #endif
 
+static uint32_t crc32Update(uint32_t crc, const uint8_t * data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return crc;
+}
+
+static void putUint32(uint8_t * buff, size_t &pos, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    buff[pos++] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
 // todo remove unused parttions when feature disabled
 enum DataIndex {
   WIFI_INDEX,
@@ -34,141 +108,513 @@ enum DataIndex {
   LAST_INDEX = ACTIONS_INDEX
 };
 
+static_assert(LAST_INDEX + 1 == SETTINGS_SECTIONS_COUNT, "Sections count mismatch");
+
 const char * const _SETTINGS_MANAGER_TAG = "settings_manager";
 const char * const _errorEepromOpen = "Failed to open EEPROM";
 
+// Copy B of storage, nullptr if there is no place for it
+static EEPROMClass * backupEeprom() {
+  #ifdef ARDUINO_ARCH_ESP32
+    // EEPROM is NVS blob there, it is replaced atomically
+    return nullptr;
+  #else
+    static EEPROMClass * backup = nullptr;
+    static bool created = false;
+    if (!created) {
+      created = true;
+      uint32_t sector = backupSector();
+      if (sector != 0) {
+        backup = new EEPROMClass(sector);
+      } else {
+        st_log_warning(_SETTINGS_MANAGER_TAG, "No free flash sector for settings backup, keeping one copy");
+      }
+    }
+    return backup;
+  #endif
+}
+
+static EEPROMClass * storageCopy(uint8_t copy) {
+  return copy == 0 ? &EEPROM : backupEeprom();
+}
+
+// Parsed storage header
+struct StoredSettings {
+  uint8_t version = 0;
+  // sections in storage, newer firmware may have more of them
+  uint8_t count = 0;
+  uint32_t sequence = 0;
+  uint16_t lengths[SETTINGS_SECTIONS_COUNT] = {};
+  uint32_t crcs[SETTINGS_SECTIONS_COUNT] = {};
+  // length of all sections, including unknown ones
+  uint32_t total = 0;
+  size_t dataStart = 0;
+  // version 2 only: crc of header to continue with sections data and the stored one
+  uint32_t crc = 0;
+  uint32_t stored = 0;
+};
+
+/*
+  Reads storage header from opened EEPROM
+  @returns false if there are no settings in current layout or header is damaged
+*/
+static bool readHeader(EEPROMClass &eeprom, StoredSettings &settings) {
+  if (eeprom.read(0) != SETTINGS_MAGIC_0 || eeprom.read(1) != SETTINGS_MAGIC_1) {
+    return false;
+  }
+
+  uint8_t byte;
+  uint32_t crc = 0xFFFFFFFF;
+  size_t pos = 0;
+  auto next = [&]() {
+    byte = eeprom.read(pos++);
+    crc = crc32Update(crc, &byte, 1);
+    return byte;
+  };
+  auto nextUint32 = [&]() {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      value |= (uint32_t) next() << (8 * i);
+    }
+    return value;
+  };
+
+  next();
+  next();
+  settings.version = next();
+  settings.count = next();
+  if (settings.version != SETTINGS_VERSION && settings.version != SETTINGS_VERSION_V2) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Unknown settings version %d", settings.version);
+    return false;
+  }
+  if (settings.version == SETTINGS_VERSION) {
+    settings.sequence = nextUint32();
+  }
+
+  for (uint8_t i = 0; i < settings.count; i++) {
+    uint32_t length = 0;
+    uint8_t shift = 0;
+    do {
+      next();
+      length |= (uint32_t) (byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) && shift < 21);
+    uint32_t sectionCrc = settings.version == SETTINGS_VERSION ? nextUint32() : 0;
+    if (i < SETTINGS_SECTIONS_COUNT) {
+      settings.lengths[i] = length;
+      settings.crcs[i] = sectionCrc;
+    }
+    settings.total += length;
+  }
+  if (pos + 4 + settings.total > SETTINGS_STORAGE_SIZE) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Bad settings header, sections don't fit in storage");
+    return false;
+  }
+
+  settings.crc = crc;
+  for (uint8_t i = 0; i < 4; i++) {
+    settings.stored |= (uint32_t) eeprom.read(pos++) << (8 * i);
+  }
+  settings.dataStart = pos;
+  if (settings.version == SETTINGS_VERSION && ~crc != settings.stored) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Settings header checksum mismatch");
+    return false;
+  }
+  return true;
+}
+
 SettingsRepositoryClass SettingsRepository;
 
 SettingsRepositoryClass::SettingsRepositoryClass() {}
 SettingsRepositoryClass::~SettingsRepositoryClass() {}
 
 void SettingsRepositoryClass::clear() {
-  if (eepromBegin()) {
-    for (int i = 0; i < EEPROM_LOAD_SIZE; i++) {
-      EEPROM.write(i, 0);
+  LockGuard guard(_lock);
+  #if SETTINGS_NVS
+    if (!_loaded && !loadNvs()) {
+      return;
     }
-    EEPROM.commit();
-    EEPROM.end();
+  #endif
+  assign(nullptr, nullptr, 0);
+  _loaded = true;
+  _dirty = SETTINGS_ALL_SECTIONS;
+  if (commitImage()) {
     st_log_warning(_SETTINGS_MANAGER_TAG, "EEPROM clear");
-  } else {
-    st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
   }
 }
 
-void SettingsRepositoryClass::read(uint16_t address, char * buff, uint16_t length) {
-  for (uint16_t i = 0; i < length; i++) {
-    buff[i] = (char) EEPROM.read(address + i);
+bool SettingsRepositoryClass::load() {
+  if (_loaded) {
+    return true;
   }
-  buff[length] = 0;
+  #if SETTINGS_NVS
+    _loaded = loadNvs();
+    return _loaded;
+  #else
+    bool rewrite = false;
+    if (!readStorage(rewrite)) {
+      st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
+      return false;
+    }
+    _loaded = true;
+
+    if (rewrite) {
+      st_log_warning(_SETTINGS_MANAGER_TAG, "Rewriting settings storage");
+      _dirty = SETTINGS_ALL_SECTIONS;
+      commitImage();
+    }
+    st_log_debug(_SETTINGS_MANAGER_TAG, "Settings loaded, used %d bytes", _offsets[SETTINGS_SECTIONS_COUNT]);
+    return true;
+  #endif
 }
 
-void SettingsRepositoryClass::write(uint16_t address, const char * buff, uint16_t length) {
-  for (uint16_t i = 0; i < length; i++) {
-    EEPROM.write(address + i, buff[i]);
+#if SETTINGS_NVS
+bool SettingsRepositoryClass::loadNvs() {
+  if (!preferences.begin(SETTINGS_NVS_NAMESPACE, false)) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Failed to open NVS namespace");
+    return false;
   }
-}
 
-int SettingsRepositoryClass::getLength(uint8_t index) {
-  if (index < FIRST_INDEX || index > LAST_INDEX) {
-    return -1;
+  if (!preferences.isKey(SETTINGS_NVS_VERSION_KEY)) {
+    // first boot after update - move settings from EEPROM region
+    bool rewrite;
+    if (!readStorage(rewrite)) {
+      assign(nullptr, nullptr, 0);
+    }
+    st_log_warning(_SETTINGS_MANAGER_TAG, "Migrating settings from EEPROM to NVS");
+    _dirty = SETTINGS_ALL_SECTIONS;
+    if (!commitImage()) {
+      return false;
+    }
+    preferences.putUChar(SETTINGS_NVS_VERSION_KEY, SETTINGS_VERSION);
+    return true;
   }
-  char buff[LENGTH_PARTITION_SIZE + 1];
-  read(index * LENGTH_PARTITION_SIZE, buff, LENGTH_PARTITION_SIZE);
-  int result = atoi(buff);
-  return result;
+
+  uint16_t lengths[SETTINGS_SECTIONS_COUNT] = {};
+  size_t total = 0;
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    size_t length = preferences.isKey(_sectionKeys[i]) ? preferences.getBytesLength(_sectionKeys[i]) : 0;
+    if (total + length > SETTINGS_STORAGE_SIZE - SETTINGS_HEADER_MAX_SIZE) {
+      st_log_error(_SETTINGS_MANAGER_TAG, "Section %s doesn't fit in memory, skipping it", _sectionKeys[i]);
+      length = 0;
+    } else if (length > 0) {
+      preferences.getBytes(_sectionKeys[i], _image + total, length);
+    }
+    lengths[i] = length;
+    total += length;
+  }
+  assign(_image, lengths, SETTINGS_SECTIONS_COUNT);
+  st_log_debug(_SETTINGS_MANAGER_TAG, "Settings loaded from NVS, used %d bytes", total);
+  return true;
 }
+#endif
 
-int SettingsRepositoryClass::writeLength(uint8_t index, int length) {
-  if (index < FIRST_INDEX || index > LAST_INDEX) {
-    return -1;
+bool SettingsRepositoryClass::readStorage(bool &rewrite) {
+  assign(nullptr, nullptr, 0);
+  rewrite = false;
+  // first commit goes to copy A
+  _copy = 1;
+  _sequence = 0;
+
+  if (!eepromBegin(EEPROM)) {
+    return false;
   }
+  StoredSettings copies[2];
+  bool valid[2] = {};
+  valid[0] = readHeader(EEPROM, copies[0]);
+  if (!valid[0] && readLegacy()) {
+    EEPROM.end();
+    rewrite = true;
+    return true;
+  }
+  EEPROM.end();
+
+  EEPROMClass * backup = backupEeprom();
+  if (backup != nullptr && eepromBegin(*backup)) {
+    valid[1] = readHeader(*backup, copies[1]);
+    backup->end();
+  }
+  if (!valid[0] && !valid[1]) {
+    return true;
+  }
+
+  uint8_t newest = !valid[1] || (valid[0] && (int32_t) (copies[0].sequence - copies[1].sequence) >= 0) ? 0 : 1;
+  uint8_t other = newest ^ 1;
+  _copy = newest;
+  _sequence = copies[newest].sequence;
+  bool repair = backup != nullptr && !valid[other];
+  if (repair) {
+    st_log_warning(_SETTINGS_MANAGER_TAG, "Settings copy %c is missing or damaged", 'A' + other);
+  }
+
+  uint8_t damaged = readSections(*storageCopy(newest), copies[newest], SETTINGS_ALL_SECTIONS);
+  repair |= damaged != 0;
+  if (damaged && valid[other]) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Settings copy %c is damaged, taking sections from copy %c", 'A' + newest, 'A' + other);
+    damaged = readSections(*storageCopy(other), copies[other], damaged);
+  }
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    if (damaged & (1 << i)) {
+      st_log_error(_SETTINGS_MANAGER_TAG, "Settings section %d is damaged in both copies, dropping it", i);
+    }
+  }
+  // commit writes the other copy, so both are valid again
+  rewrite = copies[newest].version != SETTINGS_VERSION || repair;
+  return true;
+}
+
+bool SettingsRepositoryClass::readLegacy() {
+  uint16_t lengths[SETTINGS_SECTIONS_COUNT] = {};
   char buff[LENGTH_PARTITION_SIZE + 1];
-  sprintf(buff, "%03d", length);
-  write(index * LENGTH_PARTITION_SIZE, buff, LENGTH_PARTITION_SIZE);
-  return length;
+  uint16_t total = 0;
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    for (uint8_t j = 0; j < LENGTH_PARTITION_SIZE; j++) {
+      buff[j] = (char) EEPROM.read(i * LENGTH_PARTITION_SIZE + j);
+      if (buff[j] < '0' || buff[j] > '9') {
+        // blank or unknown flash
+        return false;
+      }
+    }
+    buff[LENGTH_PARTITION_SIZE] = 0;
+    lengths[i] = atoi(buff);
+    total += lengths[i];
+  }
+  if (total == 0 || DATA_OFFSET + total > LEGACY_STORAGE_SIZE) {
+    return false;
+  }
+  for (uint16_t i = 0; i < total; i++) {
+    _image[i] = (char) EEPROM.read(DATA_OFFSET + i);
+  }
+  assign(_image, lengths, SETTINGS_SECTIONS_COUNT);
+  return true;
 }
 
-String SettingsRepositoryClass::readData(uint8_t index, const char * defaultValue) {
-  if (index < FIRST_INDEX || index > LAST_INDEX) {
-    return defaultValue;
+uint8_t SettingsRepositoryClass::readSections(EEPROMClass &eeprom, const StoredSettings &stored, uint8_t sections) {
+  if (!eepromBegin(eeprom)) {
+    return sections;
   }
-  if (eepromBegin()) {
-    int targetLength = getLength(index);
-    if (targetLength == 0) {
-      EEPROM.end();
-      return defaultValue;
+  uint8_t byte;
+  if (stored.version == SETTINGS_VERSION_V2) {
+    uint32_t crc = stored.crc;
+    for (uint32_t i = 0; i < stored.total; i++) {
+      byte = eeprom.read(stored.dataStart + i);
+      crc = crc32Update(crc, &byte, 1);
     }
-
-    int offset = DATA_OFFSET;
-    for (int i = 0; i < index; i++) {
-      offset += getLength(i);
+    if (~crc != stored.stored) {
+      eeprom.end();
+      return sections;
     }
+  }
 
-    char buff[targetLength + 1];
-    read(offset, buff, targetLength);
+  uint8_t damaged = 0;
+  std::vector<char> data;
+  size_t pos = stored.dataStart;
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT && i < stored.count; pos += stored.lengths[i], i++) {
+    if (!(sections & (1 << i))) {
+      continue;
+    }
+    uint16_t length = stored.lengths[i];
+    data.resize(length);
+    for (uint16_t j = 0; j < length; j++) {
+      data[j] = (char) eeprom.read(pos + j);
+    }
+    bool valid = stored.version == SETTINGS_VERSION_V2
+      || ~crc32Update(0xFFFFFFFF, (const uint8_t *) data.data(), length) == stored.crcs[i];
+    if (!valid || !put(i, data.data(), length)) {
+      damaged |= 1 << i;
+    }
+  }
+  eeprom.end();
+  return damaged;
+}
 
-    String result = buff;
+bool SettingsRepositoryClass::assign(const char * data, const uint16_t * lengths, uint8_t count) {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    total += lengths[i];
+  }
+  if (total > SETTINGS_STORAGE_SIZE - SETTINGS_HEADER_MAX_SIZE) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Settings are too big (%d bytes)", total);
+    return false;
+  }
 
-    EEPROM.end();
-    return result;
-  } else {
-    st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
-    return defaultValue;
+  if (data != nullptr && data != _image) {
+    memcpy(_image, data, total);
   }
+  uint16_t offset = 0;
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    _offsets[i] = offset;
+    if (i < count) {
+      offset += lengths[i];
+    }
+  }
+  _offsets[SETTINGS_SECTIONS_COUNT] = offset;
+  return true;
 }
 
-int SettingsRepositoryClass::writeData(uint8_t index, const char * data) {
-  if (index < FIRST_INDEX || index > LAST_INDEX || data == nullptr) {
-    return -1;
+size_t SettingsRepositoryClass::buildHeader(uint8_t * header, uint32_t sequence) {
+  size_t pos = 0;
+  header[pos++] = SETTINGS_MAGIC_0;
+  header[pos++] = SETTINGS_MAGIC_1;
+  header[pos++] = SETTINGS_VERSION;
+  header[pos++] = SETTINGS_SECTIONS_COUNT;
+  putUint32(header, pos, sequence);
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    uint32_t length = _offsets[i + 1] - _offsets[i];
+    uint32_t crc = ~crc32Update(0xFFFFFFFF, (const uint8_t *) _image + _offsets[i], length);
+    do {
+      uint8_t byte = length & 0x7F;
+      length >>= 7;
+      header[pos++] = length > 0 ? byte | 0x80 : byte;
+    } while (length > 0);
+    putUint32(header, pos, crc);
   }
 
-  if (eepromBegin()) {
-    int tmp = 0, offset = DATA_OFFSET, targetLength = 0, tailLength = 0;
-    targetLength = getLength(index);
-    if (targetLength < 0) {
-      return -1;
-    }
+  uint32_t crc = ~crc32Update(0xFFFFFFFF, header, pos);
+  putUint32(header, pos, crc);
+  return pos;
+}
+
+void SettingsRepositoryClass::markDirty(uint8_t index) {
+  _dirty |= 1 << index;
+  _lastWrite = millis();
+}
 
-    for (int i = 0; i < index; i++) {
-      tmp = getLength(i);
-      if (tmp < 0) {
-        return -1;
+bool SettingsRepositoryClass::commitImage() {
+  if (!_dirty) {
+    return true;
+  }
+
+  #if SETTINGS_NVS
+    // each section is a separate NVS entry, unchanged ones are not touched
+    bool res = true;
+    for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+      if (!(_dirty & (1 << i))) {
+        continue;
+      }
+      size_t length = _offsets[i + 1] - _offsets[i];
+      bool written = length == 0
+        ? !preferences.isKey(_sectionKeys[i]) || preferences.remove(_sectionKeys[i])
+        : preferences.putBytes(_sectionKeys[i], _image + _offsets[i], length) == length;
+      if (written) {
+        _dirty &= ~(1 << i);
+      } else {
+        st_log_error(_SETTINGS_MANAGER_TAG, "Failed to write section %s", _sectionKeys[i]);
+        res = false;
       }
-      offset += tmp;
     }
-
-    char oldData[targetLength + 1];
-    read(offset, oldData, targetLength);
-    if (strcmp(oldData, data) == 0) {
-      st_log_debug(_SETTINGS_MANAGER_TAG, "Old data equals new, not writing");
-      return targetLength;
+  #else
+    // the older copy is overwritten, without backup only per section crc is left
+    uint8_t copy = backupEeprom() != nullptr ? _copy ^ 1 : 0;
+    EEPROMClass &eeprom = *storageCopy(copy);
+    if (!eepromBegin(eeprom)) {
+      st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
+      return false;
     }
 
-    for (int i = index + 1; i <= LAST_INDEX; i++) {
-      tmp = getLength(i);
-      if (tmp < 0) {
-        return -1;
+    uint8_t header[SETTINGS_HEADER_MAX_SIZE];
+    size_t headerSize = buildHeader(header, _sequence + 1);
+    size_t used = _offsets[SETTINGS_SECTIONS_COUNT];
+    uint8_t byte;
+    for (size_t i = 0; i < headerSize + used; i++) {
+      byte = i < headerSize ? header[i] : (uint8_t) _image[i - headerSize];
+      if (eeprom.read(i) != byte) {
+        eeprom.write(i, byte);
       }
-      tailLength += tmp;
     }
+    bool res = eeprom.commit();
+    eeprom.end();
+    if (res) {
+      _dirty = 0;
+      _copy = copy;
+      _sequence++;
+    }
+  #endif
+
+  if (res) {
+    st_log_debug(_SETTINGS_MANAGER_TAG, "Settings commited");
+  } else {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Failed to commit settings");
+  }
+  return res;
+}
 
-    char buffTail[tailLength + 1];
-    read(offset + targetLength, buffTail, tailLength);
-    
-    int dataLen = strlen(data);
+bool SettingsRepositoryClass::commit() {
+  LockGuard guard(_lock);
+  return commitImage();
+}
 
-    write(offset, data, dataLen);
-    write(offset + dataLen, buffTail, strlen(buffTail));
-    writeLength(index, dataLen);
+void SettingsRepositoryClass::tick() {
+  LockGuard guard(_lock);
+  if (_dirty && millis() - _lastWrite >= SETTINGS_COMMIT_DELAY) {
+    commitImage();
+  }
+}
 
-    EEPROM.commit();
-    EEPROM.end();
+String SettingsRepositoryClass::readData(uint8_t index, const char * defaultValue) {
+  if (index < FIRST_INDEX || index > LAST_INDEX) {
+    return defaultValue;
+  }
+  LockGuard guard(_lock);
+  if (!load()) {
+    return defaultValue;
+  }
+  uint16_t length = _offsets[index + 1] - _offsets[index];
+  if (length == 0) {
+    return defaultValue;
+  }
+  String result;
+  result.concat(_image + _offsets[index], length);
+  return result;
+}
 
+int SettingsRepositoryClass::writeData(uint8_t index, const char * data) {
+  if (data == nullptr) {
+    return -1;
+  }
+  return writeData(index, data, strlen(data));
+}
+
+int SettingsRepositoryClass::writeData(uint8_t index, const char * data, size_t dataLen) {
+  if (index < FIRST_INDEX || index > LAST_INDEX || (data == nullptr && dataLen > 0)) {
+    return -1;
+  }
+  LockGuard guard(_lock);
+  if (!load()) {
+    return -1;
+  }
+
+  uint16_t oldLength = _offsets[index + 1] - _offsets[index];
+  if (dataLen == oldLength && memcmp(_image + _offsets[index], data, dataLen) == 0) {
+    st_log_debug(_SETTINGS_MANAGER_TAG, "Old data equals new, not writing");
     return dataLen;
-  } else {
-    st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
+  }
+  if (!put(index, data, dataLen)) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Not enough space for data (%d bytes)", dataLen);
     return -1;
   }
+  markDirty(index);
+
+  return dataLen;
+}
+
+bool SettingsRepositoryClass::put(uint8_t index, const char * data, size_t length) {
+  uint16_t offset = _offsets[index];
+  uint16_t oldLength = _offsets[index + 1] - offset;
+  uint16_t used = _offsets[SETTINGS_SECTIONS_COUNT];
+  if (used - oldLength + length > SETTINGS_STORAGE_SIZE - SETTINGS_HEADER_MAX_SIZE) {
+    return false;
+  }
+
+  // shift following sections and put new data in place
+  memmove(_image + offset + length, _image + offset + oldLength, used - offset - oldLength);
+  if (length > 0) {
+    memcpy(_image + offset, data, length);
+  }
+  for (uint8_t i = index + 1; i <= SETTINGS_SECTIONS_COUNT; i++) {
+    _offsets[i] = _offsets[i] - oldLength + length;
+  }
+  return true;
 }
 
 bool SettingsRepositoryClass::setData(uint8_t index, const char * data, const char * name, size_t expectedLength) {
@@ -317,12 +763,22 @@ bool SettingsRepositoryClass::setConfig(const String &config) {
 #endif
 
 #if ENABLE_HOOKS
-bool SettingsRepositoryClass::setHooks(const String &data) {
-  return setData(HOOKS_INDEX, data.c_str(), "hooks");
+bool SettingsRepositoryClass::setHooks(const uint8_t * data, size_t length) {
+  if (writeData(HOOKS_INDEX, (const char *) data, length) != (int) length) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Failed to update [hooks] data");
+    return false;
+  }
+  st_log_debug(_SETTINGS_MANAGER_TAG, "Data [hooks] updated");
+  return true;
 }
 
-String SettingsRepositoryClass::getHooks() {
-  return readData(HOOKS_INDEX);
+bool SettingsRepositoryClass::readHooks(std::function<void(const uint8_t * data, size_t length)> reader) {
+  LockGuard guard(_lock);
+  if (!load()) {
+    return false;
+  }
+  reader((const uint8_t *) _image + _offsets[HOOKS_INDEX], _offsets[HOOKS_INDEX + 1] - _offsets[HOOKS_INDEX]);
+  return true;
 }
 #endif
 
@@ -340,33 +796,37 @@ JsonDocument SettingsRepositoryClass::getActions() {
 
 String SettingsRepositoryClass::exportSettings() {
   String result = "";
-  if (eepromBegin()) {
-    uint8_t tmp = 0;
-    int actualSize = DATA_OFFSET;
-    for (uint8_t i = 0; i <= LAST_INDEX; i++) {
-      actualSize += getLength(i);
-    }
-
-    char buff[actualSize + 1];
-    for (uint16_t i = 0; i < actualSize; i++) {
-      tmp = EEPROM.read(i);
-      if (i < DATA_OFFSET && (tmp < '0' || tmp > '9')) {
-        tmp = '0';
-      }
-      buff[i] = (char) tmp;
-    }
-    buff[actualSize] = 0;
-    EEPROM.end(); 
-    result = buff;
-
-    result.replace("\n", "\\n");
-    result.replace("\t", "\\t");
-
-    return result;
-  } else {
-    st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
+  LockGuard guard(_lock);
+  if (!load()) {
     return result;
   }
+
+  // ST3[count][length of each section][escaped data], count and lengths in hex
+  char buff[8];
+  result.reserve(strlen(DUMP_PREFIX) + 2 + 4 * SETTINGS_SECTIONS_COUNT + _offsets[SETTINGS_SECTIONS_COUNT]);
+  result += DUMP_PREFIX;
+  sprintf(buff, "%02x", SETTINGS_SECTIONS_COUNT);
+  result += buff;
+  for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+    sprintf(buff, "%04x", _offsets[i + 1] - _offsets[i]);
+    result += buff;
+  }
+  for (uint16_t i = 0; i < _offsets[SETTINGS_SECTIONS_COUNT]; i++) {
+    uint8_t c = _image[i];
+    if (c == '\\') {
+      result += "\\\\";
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (c == '\t') {
+      result += "\\t";
+    } else if (c < 0x20 || c >= 0x7f) {
+      sprintf(buff, "\\x%02x", c);
+      result += buff;
+    } else {
+      result += (char) c;
+    }
+  }
+  return result;
 }
 
 bool SettingsRepositoryClass::importSettings(String &dump) {
@@ -380,37 +840,101 @@ bool SettingsRepositoryClass::importSettings(String &dump) {
     return false;
   }
 
-  bool valid = true;
-  uint8_t tmp;
-  for (uint8_t i = 0; i < DATA_OFFSET; i++) {
-    tmp = dump.charAt(i) - '0';
-    if ('0' < tmp || tmp > '9') {
-      valid = false;
-      break;
+  uint16_t lengths[SETTINGS_SECTIONS_COUNT] = {};
+  uint8_t count = 0;
+  size_t dataStart = 0;
+  uint32_t total = 0;
+  char buff[5];
+  bool escaped = dump.startsWith(DUMP_PREFIX);
+  if (escaped || dump.startsWith(DUMP_PREFIX_V2)) {
+    size_t pos = strlen(DUMP_PREFIX);
+    if (dump.length() < pos + 2) {
+      st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - too short");
+      return false;
+    }
+    uint8_t dumpCount = strtol(dump.substring(pos, pos + 2).c_str(), nullptr, 16);
+    pos += 2;
+    if (dump.length() < pos + 4 * dumpCount) {
+      st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - wrong partitions lengths");
+      return false;
+    }
+    for (uint8_t i = 0; i < dumpCount; i++, pos += 4) {
+      memcpy(buff, dump.c_str() + pos, 4);
+      buff[4] = 0;
+      char * end;
+      uint16_t length = strtol(buff, &end, 16);
+      if (end != buff + 4) {
+        st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - wrong partitions lengths");
+        return false;
+      }
+      // unknown sections are dropped, they are expected to be the last ones
+      if (i < SETTINGS_SECTIONS_COUNT) {
+        lengths[i] = length;
+        total += length;
+      }
+    }
+    count = dumpCount < SETTINGS_SECTIONS_COUNT ? dumpCount : SETTINGS_SECTIONS_COUNT;
+    dataStart = pos;
+  } else {
+    // legacy layout dump
+    if (dump.length() < DATA_OFFSET) {
+      st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - too short");
+      return false;
+    }
+    for (uint8_t i = 0; i < SETTINGS_SECTIONS_COUNT; i++) {
+      for (uint8_t j = 0; j < LENGTH_PARTITION_SIZE; j++) {
+        buff[j] = dump.charAt(i * LENGTH_PARTITION_SIZE + j);
+        if (buff[j] < '0' || buff[j] > '9') {
+          st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - worng partitions lengths");
+          return false;
+        }
+      }
+      buff[LENGTH_PARTITION_SIZE] = 0;
+      lengths[i] = atoi(buff);
+      total += lengths[i];
     }
+    count = SETTINGS_SECTIONS_COUNT;
+    dataStart = DATA_OFFSET;
   }
-  // todo check if dump contains only ascii?
-  if (!valid) {
-    st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - worng partitions lengths");
+
+  std::vector<char> data;
+  data.reserve(total);
+  const char * raw = dump.c_str();
+  for (size_t i = dataStart; i < dump.length(); i++) {
+    char c = raw[i];
+    if (c == '\\' && i + 1 < dump.length()) {
+      char next = raw[i + 1];
+      if (next == 'n' || next == 't') {
+        c = next == 'n' ? '\n' : '\t';
+        i++;
+      } else if (escaped && next == '\\') {
+        i++;
+      } else if (escaped && next == 'x' && i + 3 < dump.length()) {
+        memcpy(buff, raw + i + 2, 2);
+        buff[2] = 0;
+        c = (char) strtol(buff, nullptr, 16);
+        i += 3;
+      }
+    }
+    data.push_back(c);
+  }
+  if (data.size() < total) {
+    st_log_error(_SETTINGS_MANAGER_TAG, "Bad dump - data is shorter than partitions");
     return false;
   }
 
-  dump.replace("\\n", "\n");
-  dump.replace("\\t", "\t");
-  
-  if (eepromBegin()) {
-    st_log_warning(_SETTINGS_MANAGER_TAG, "Writing dump in eeprom (size=%d)", dump.length());
-    st_log_debug(_SETTINGS_MANAGER_TAG, "Dump=%s", dump.c_str());
+  st_log_warning(_SETTINGS_MANAGER_TAG, "Writing dump in eeprom (size=%d)", total);
+  st_log_debug(_SETTINGS_MANAGER_TAG, "Dump=%s", dump.c_str());
 
-    for (uint16_t i = 0; i < dump.length(); i++) {
-      EEPROM.write(i, dump.charAt(i));
-    }
-    EEPROM.commit();
-    EEPROM.end();
-    st_log_warning(_SETTINGS_MANAGER_TAG, "Dump write finished");
-    return true;
-  } else {
-    st_log_error(_SETTINGS_MANAGER_TAG, _errorEepromOpen);
+  LockGuard guard(_lock);
+  if (!load() || !assign(data.data(), lengths, count)) {
+    return false;
+  }
+  _loaded = true;
+  _dirty = SETTINGS_ALL_SECTIONS;
+  if (!commitImage()) {
     return false;
   }
-}
\ No newline at end of file
+  st_log_warning(_SETTINGS_MANAGER_TAG, "Dump write finished");
+  return true;
+}
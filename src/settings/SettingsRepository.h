@@ -2,11 +2,51 @@
 #define SettingsRepository_H
 
 #include <ArduinoJson.h>
+#include <EEPROM.h>
 #include <functional>
 #include <list>
 
 #include "Features.h"
 #include "logs/BetterLogger.h"
+#include "utils/Lock.h"
+
+// Size of flash region with settings (header + all sections)
+#ifndef SETTINGS_STORAGE_SIZE
+  #ifdef ARDUINO_ARCH_ESP32
+    #define SETTINGS_STORAGE_SIZE 4096
+  #else
+    #define SETTINGS_STORAGE_SIZE 2048
+  #endif
+#endif
+// name, wifi, config, hooks, actions
+#define SETTINGS_SECTIONS_COUNT 5
+#define SETTINGS_ALL_SECTIONS ((1 << SETTINGS_SECTIONS_COUNT) - 1)
+
+/*
+  Keep settings in NVS (Preferences) instead of EEPROM region.
+  NVS is journaled and wear-leveled, each section is a separate entry,
+  so only changed sections are written and power loss can't break the others.
+*/
+#ifndef SETTINGS_NVS
+  #ifdef ARDUINO_ARCH_ESP32
+    #define SETTINGS_NVS 1
+  #else
+    #define SETTINGS_NVS 0
+  #endif
+#endif
+
+/*
+  Flash sector for backup copy of EEPROM settings on esp8266.
+  0 - sector right before EEPROM one if file system doesn't use it, otherwise there is only one copy.
+*/
+#ifndef SETTINGS_BACKUP_SECTOR
+  #define SETTINGS_BACKUP_SECTOR 0
+#endif
+
+// Pending settings changes are written to flash after this time without new writes (ms)
+#ifndef SETTINGS_COMMIT_DELAY
+  #define SETTINGS_COMMIT_DELAY 1000
+#endif
 
 enum StWiFiMode {
   ST_WIFI_STA = 1,
@@ -20,6 +60,9 @@ struct WiFiConfig {
   StWiFiMode mode;
 };
 
+// Parsed storage header, see SettingsRepository.cpp
+struct StoredSettings;
+
 class SettingsRepositoryClass {
  public:
   SettingsRepositoryClass();
@@ -37,8 +80,13 @@ class SettingsRepositoryClass {
   #endif
 
   #if ENABLE_HOOKS
-    String getHooks();
-    bool setHooks(const String &data);
+    /*
+      Gives hooks section to reader without copying
+      Reader is called under settings lock, so it must not use SettingsRepository
+      @returns false if settings can't be loaded
+    */
+    bool readHooks(std::function<void(const uint8_t * data, size_t length)> reader);
+    bool setHooks(const uint8_t * data, size_t length);
   #endif
 
   #if ENABLE_ACTIONS_SCHEDULER
@@ -50,15 +98,63 @@ class SettingsRepositoryClass {
   bool importSettings(String &dump);
   
   void clear();
- private:
-  void read(uint16_t address, char * buff, uint16_t length);
-  void write(uint16_t address, const char * buff, uint16_t length);
 
-  int getLength(uint8_t index);
-  int writeLength(uint8_t index, int length);
+  /*
+    Write pending changes to flash right away.
+    Call it before restart if settings were just changed.
+    @returns false if flash write failed
+  */
+  bool commit();
+  // Commits pending changes after SETTINGS_COMMIT_DELAY of no writes, called from SmartThing.loop()
+  void tick();
+ private:
+  // Sections data without header, all reads and writes go here
+  char _image[SETTINGS_STORAGE_SIZE];
+  // Section start offsets in image, last one - end of used data
+  uint16_t _offsets[SETTINGS_SECTIONS_COUNT + 1];
+  bool _loaded = false;
+  // bitmask of changed sections
+  uint8_t _dirty = 0;
+  unsigned long _lastWrite = 0;
+  // storage copy with current settings (0 - A, 1 - B) and its sequence number
+  uint8_t _copy = 1;
+  uint32_t _sequence = 0;
+  Lock _lock;
+
+  bool load();
+  /*
+    Reads settings from the newest valid storage copy
+    @param rewrite set to true if storage has older layout or damaged sections
+    @returns false if EEPROM can't be opened
+  */
+  bool readStorage(bool &rewrite);
+  // Reads legacy text layout from opened EEPROM, @returns false if there is none
+  bool readLegacy();
+  /*
+    Loads sections of storage copy into image, skips damaged ones
+    @param sections bitmask of sections to load
+    @returns bitmask of damaged sections
+  */
+  uint8_t readSections(EEPROMClass &eeprom, const StoredSettings &stored, uint8_t sections);
+  #if SETTINGS_NVS
+    bool loadNvs();
+  #endif
+  /*
+    Replace all sections
+    @param data sections data one after another
+    @param lengths length of each section
+    @param count sections count in data
+  */
+  bool assign(const char * data, const uint16_t * lengths, uint8_t count);
+  // Replace section data in image, @returns false if it doesn't fit
+  bool put(uint8_t index, const char * data, size_t length);
+  size_t buildHeader(uint8_t * header, uint32_t sequence);
+  void markDirty(uint8_t index);
+  bool commitImage();
 
   String readData(uint8_t index, const char * defaultValue = "");
   int writeData(uint8_t index, const char * data);
+  int writeData(uint8_t index, const char * data, size_t length);
   /*
   Helper method for writeData
   Checks writes data length, prints messages
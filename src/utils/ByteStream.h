@@ -0,0 +1,154 @@
+#ifndef BYTE_STREAM_H
+#define BYTE_STREAM_H
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+  Writer of compact binary records for settings storage.
+  Numbers are varints (signed ones are zigzag encoded),
+  strings are [varint length][bytes][0] so reader can use them in place.
+*/
+class ByteWriter {
+  public:
+    void writeByte(uint8_t value) {
+      _data.push_back(value);
+    }
+
+    void writeVarint(uint32_t value) {
+      while (value >= 0x80) {
+        _data.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      _data.push_back(value);
+    }
+
+    void writeSigned(int32_t value) {
+      writeVarint(((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+    }
+
+    void writeString(const char * value, size_t length) {
+      writeVarint(length);
+      _data.insert(_data.end(), (const uint8_t *) value, (const uint8_t *) value + length);
+      _data.push_back(0);
+    }
+
+    void writeString(const char * value) {
+      writeString(value == nullptr ? "" : value, value == nullptr ? 0 : strlen(value));
+    }
+
+    void writeString(const String &value) {
+      writeString(value.c_str(), value.length());
+    }
+
+    // Reserves place for record length, returns record start for endRecord
+    size_t beginRecord() {
+      _data.push_back(0);
+      _data.push_back(0);
+      return _data.size();
+    }
+
+    // Puts length of record started at start (2 bytes, little endian)
+    void endRecord(size_t start) {
+      size_t length = _data.size() - start;
+      _data[start - 2] = length & 0xff;
+      _data[start - 1] = (length >> 8) & 0xff;
+    }
+
+    const uint8_t * data() const { return _data.data(); }
+    size_t length() const { return _data.size(); }
+
+  private:
+    std::vector<uint8_t> _data;
+};
+
+/*
+  Reader over ByteWriter output, doesn't copy anything.
+  Any read past the end or malformed value marks reader as failed,
+  after that all reads return zero values.
+*/
+class ByteReader {
+  public:
+    ByteReader(const uint8_t * data, size_t length): _data(data), _length(length) {};
+
+    uint8_t readByte() {
+      if (!require(1)) {
+        return 0;
+      }
+      return _data[_position++];
+    }
+
+    uint32_t readVarint() {
+      uint32_t value = 0;
+      for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (!require(1)) {
+          return 0;
+        }
+        uint8_t byte = _data[_position++];
+        value |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+          return value;
+        }
+      }
+      _failed = true;
+      return 0;
+    }
+
+    int32_t readSigned() {
+      uint32_t value = readVarint();
+      return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+    }
+
+    /*
+      Returns pointer to string inside the buffer
+      @param length optional place for string length
+      @returns nullptr on failure
+    */
+    const char * readString(size_t * length = nullptr) {
+      uint32_t size = readVarint();
+      if (!require(size + 1) || _data[_position + size] != 0) {
+        _failed = true;
+        return nullptr;
+      }
+      const char * result = (const char *) _data + _position;
+      _position += size + 1;
+      if (length != nullptr) {
+        *length = size;
+      }
+      return result;
+    }
+
+    // Reads record written between beginRecord and endRecord
+    ByteReader readRecord() {
+      size_t length = readByte();
+      length |= (size_t) readByte() << 8;
+      if (_failed || !require(length)) {
+        _failed = true;
+        return ByteReader(nullptr, 0, true);
+      }
+      ByteReader record(_data + _position, length);
+      _position += length;
+      return record;
+    }
+
+    bool failed() const { return _failed; }
+    bool atEnd() const { return _position >= _length; }
+
+  private:
+    ByteReader(const uint8_t * data, size_t length, bool failed): _data(data), _length(length), _failed(failed) {};
+
+    const uint8_t * _data;
+    size_t _length;
+    size_t _position = 0;
+    bool _failed = false;
+
+    bool require(size_t count) {
+      if (_failed || _length - _position < count) {
+        _failed = true;
+        return false;
+      }
+      return true;
+    }
+};
+
+#endif
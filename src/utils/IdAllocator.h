@@ -0,0 +1,73 @@
+#ifndef ID_ALLOCATOR_H
+#define ID_ALLOCATOR_H
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+  Hands out ids from 1 to maxId, backed by bitmap of used ones.
+  New id is the lowest free one, so ids stay dense and bitmap small
+  (it grows only up to the biggest used id).
+*/
+class IdAllocator {
+  public:
+    // id 0 is never given out, so its bit is set from the start
+    IdAllocator(uint32_t maxId): _used(1, 1), _maxId(maxId) {};
+
+    // @returns new id or -1 if all ids are taken
+    int32_t allocate() {
+      for (size_t i = _firstFree; i < _used.size(); i++) {
+        if (_used[i] != 0xFFFFFFFF) {
+          _firstFree = i;
+          return take(i * 32 + __builtin_ctz(~_used[i]));
+        }
+      }
+      _firstFree = _used.size();
+      return take(_used.size() * 32);
+    }
+
+    /*
+      Mark id as used (for ids loaded from settings)
+      @returns false if id is already used or out of range
+    */
+    bool reserve(uint32_t id) {
+      if (id == 0 || id > _maxId || isUsed(id)) {
+        return false;
+      }
+      grow(id);
+      _used[id / 32] |= 1UL << (id % 32);
+      return true;
+    }
+
+    void release(uint32_t id) {
+      if (!isUsed(id)) {
+        return;
+      }
+      _used[id / 32] &= ~(1UL << (id % 32));
+      if (id / 32 < _firstFree) {
+        _firstFree = id / 32;
+      }
+    }
+
+    bool isUsed(uint32_t id) const {
+      return id / 32 < _used.size() && (_used[id / 32] & (1UL << (id % 32)));
+    }
+
+  private:
+    std::vector<uint32_t> _used;
+    // words before this one have no free ids
+    size_t _firstFree = 0;
+    uint32_t _maxId;
+
+    int32_t take(uint32_t id) {
+      return reserve(id) ? id : -1;
+    }
+
+    void grow(uint32_t id) {
+      if (id / 32 >= _used.size()) {
+        _used.resize(id / 32 + 1, 0);
+      }
+    }
+};
+
+#endif
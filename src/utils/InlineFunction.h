@@ -0,0 +1,153 @@
+#ifndef INLINE_FUNCTION_H
+#define INLINE_FUNCTION_H
+
+#include <Arduino.h>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Max size of lambda captures (bytes) stored by InlineFunction
+#ifndef INLINE_FUNCTION_CAPACITY
+  #define INLINE_FUNCTION_CAPACITY 16
+#endif
+
+template <typename Signature, size_t Capacity = INLINE_FUNCTION_CAPACITY>
+class InlineFunction;
+
+/*
+  std::function replacement which never allocates: callable is stored
+  in a fixed buffer inside the object. Callable which doesn't fit
+  fails to compile (raise INLINE_FUNCTION_CAPACITY or capture less).
+  Calling empty function returns R().
+*/
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+  private:
+    // accepts callables with compatible signature only, so overloads by signature work like with std::function
+    template <typename F, typename Result = decltype(std::declval<F&>()(std::declval<Args>()...))>
+    using EnableIfCallable = typename std::enable_if<
+      !std::is_same<typename std::decay<F>::type, InlineFunction>::value &&
+      (std::is_void<R>::value || std::is_convertible<Result, R>::value)
+    >::type;
+
+  public:
+    InlineFunction() {};
+    InlineFunction(std::nullptr_t) {};
+
+    template <typename F, typename = EnableIfCallable<F>>
+    InlineFunction(F callable) {
+      typedef typename std::decay<F>::type Callable;
+      static_assert(sizeof(Callable) <= Capacity, "Lambda captures don't fit InlineFunction, raise INLINE_FUNCTION_CAPACITY");
+      static_assert(alignof(Callable) <= alignof(std::max_align_t), "Lambda captures alignment isn't supported by InlineFunction");
+      new (_storage) Callable(std::move(callable));
+      _invoke = &invoke<Callable>;
+      _manage = &manage<Callable>;
+    }
+
+    InlineFunction(const InlineFunction &other) {
+      copyFrom(other);
+    }
+
+    InlineFunction(InlineFunction &&other) {
+      moveFrom(other);
+    }
+
+    ~InlineFunction() {
+      reset();
+    }
+
+    InlineFunction &operator=(const InlineFunction &other) {
+      if (this != &other) {
+        reset();
+        copyFrom(other);
+      }
+      return *this;
+    }
+
+    InlineFunction &operator=(InlineFunction &&other) {
+      if (this != &other) {
+        reset();
+        moveFrom(other);
+      }
+      return *this;
+    }
+
+    InlineFunction &operator=(std::nullptr_t) {
+      reset();
+      return *this;
+    }
+
+    explicit operator bool() const {
+      return _invoke != nullptr;
+    }
+
+    R operator()(Args... args) const {
+      if (_invoke == nullptr) {
+        return R();
+      }
+      return _invoke((void *) _storage, std::forward<Args>(args)...);
+    }
+
+  private:
+    enum Operation {
+      COPY,
+      MOVE,
+      DESTROY
+    };
+
+    typedef R (*Invoker)(void * callable, Args... args);
+    // copy/move source into target or destroy target
+    typedef void (*Manager)(Operation operation, void * target, void * source);
+
+    alignas(std::max_align_t) unsigned char _storage[Capacity];
+    Invoker _invoke = nullptr;
+    Manager _manage = nullptr;
+
+    template <typename Callable>
+    static R invoke(void * callable, Args... args) {
+      return (*(Callable *) callable)(std::forward<Args>(args)...);
+    }
+
+    template <typename Callable>
+    static void manage(Operation operation, void * target, void * source) {
+      switch (operation) {
+        case COPY:
+          new (target) Callable(*(const Callable *) source);
+          break;
+        case MOVE:
+          new (target) Callable(std::move(*(Callable *) source));
+          break;
+        case DESTROY:
+          ((Callable *) target)->~Callable();
+          break;
+      }
+    }
+
+    void reset() {
+      if (_manage != nullptr) {
+        _manage(DESTROY, _storage, nullptr);
+      }
+      _invoke = nullptr;
+      _manage = nullptr;
+    }
+
+    void copyFrom(const InlineFunction &other) {
+      if (other._manage != nullptr) {
+        other._manage(COPY, _storage, (void *) other._storage);
+      }
+      _invoke = other._invoke;
+      _manage = other._manage;
+    }
+
+    void moveFrom(InlineFunction &other) {
+      if (other._manage != nullptr) {
+        other._manage(MOVE, _storage, other._storage);
+      }
+      _invoke = other._invoke;
+      _manage = other._manage;
+      other.reset();
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "utils/InternTable.h"
+
+#if ENABLE_TEXT_SENSORS
+
+#include "utils/NameIndex.h"
+
+InternTableClass InternTable;
+
+InternId InternTableClass::lookup(const String &value, bool add) {
+  if (value.length() > TEXT_INTERN_MAX_LENGTH) {
+    return INTERN_NONE;
+  }
+  uint32_t hash = hashName(value.c_str());
+
+  LockGuard guard(_lock);
+  // table is at most half full, so there is always an empty slot to stop at
+  const size_t mask = TEXT_INTERN_SLOTS - 1;
+  for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+    InternId id = _slots[slot];
+    if (id == INTERN_NONE) {
+      if (!add) {
+        return INTERN_NONE;
+      }
+      if (full()) {
+        _rejected++;
+        return INTERN_NONE;
+      }
+      _entries.push_back({hash, value});
+      _slots[slot] = _entries.size() - 1;
+      return _slots[slot];
+    }
+    if (_entries[id].hash == hash && _entries[id].value.equals(value)) {
+      return id;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef INTERN_TABLE_H
+#define INTERN_TABLE_H
+
+#include "Features.h"
+
+#include <Arduino.h>
+#include <vector>
+
+#include "utils/Lock.h"
+
+typedef uint16_t InternId;
+
+// Id of value which is not in the table
+#define INTERN_NONE 0xFFFF
+
+#if ENABLE_TEXT_SENSORS
+
+// Max count of distinct interned values (hook triggers), entries are never removed
+#ifndef TEXT_INTERN_MAX_ENTRIES
+  #define TEXT_INTERN_MAX_ENTRIES 64
+#endif
+
+// Longer values are not interned
+#ifndef TEXT_INTERN_MAX_LENGTH
+  #define TEXT_INTERN_MAX_LENGTH 32
+#endif
+
+#define TEXT_INTERN_SLOTS internSlotsCount(TEXT_INTERN_MAX_ENTRIES)
+
+// Hash slots count: power of two, at least twice entries count, so probe sequences stay short
+constexpr size_t internSlotsCount(size_t entries, size_t slots = 1) {
+  return slots >= 2 * entries ? slots : internSlotsCount(entries, slots * 2);
+}
+
+/*
+  Table of short text values, each distinct value gets a small id, so equal values have equal ids.
+  Hook triggers are added, sensor values are only looked up: value equal to some trigger
+  gets its id, the others are compared as strings.
+  When table is full or value is too long, INTERN_NONE is returned
+  and caller has to compare strings.
+  Ids are kept in open addressing hash table (linear probing), lookup doesn't scan entries.
+*/
+class InternTableClass {
+  public:
+    InternTableClass() {
+      // entries never move, so value(id) references stay valid
+      _entries.reserve(TEXT_INTERN_MAX_ENTRIES);
+      for (size_t i = 0; i < TEXT_INTERN_SLOTS; i++) {
+        _slots[i] = INTERN_NONE;
+      }
+    }
+
+    /*
+      Find value id, add value to table if it's missing
+      @returns value id or INTERN_NONE
+    */
+    InternId intern(const String &value) {
+      return lookup(value, true);
+    }
+
+    /*
+      Find value id without adding it to table
+      @returns value id or INTERN_NONE
+    */
+    InternId find(const String &value) {
+      return lookup(value, false);
+    }
+
+    // Interned value, id must be returned by intern or find
+    const String &value(InternId id) const {
+      return _entries[id].value;
+    }
+
+    size_t size() const {
+      return _entries.size();
+    }
+
+    bool full() const {
+      return _entries.size() >= TEXT_INTERN_MAX_ENTRIES;
+    }
+
+    // Values which weren't added because table was full
+    unsigned long rejected() const {
+      return _rejected;
+    }
+
+  private:
+    struct Entry {
+      uint32_t hash;
+      String value;
+    };
+
+    std::vector<Entry> _entries;
+    // entry ids by hash, INTERN_NONE - empty slot
+    InternId _slots[TEXT_INTERN_SLOTS];
+    unsigned long _rejected = 0;
+    Lock _lock;
+
+    InternId lookup(const String &value, bool add);
+};
+
+extern InternTableClass InternTable;
+
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <Arduino.h>
+
+/*
+  Mutex for data shared between FreeRTOS tasks (loop task, web server task, workers).
+  esp8266 runs everything in one context, so there it does nothing.
+  Mutex is kept inside the lock (no heap allocation), so lock can't be copied or moved.
+*/
+class Lock {
+  public:
+    Lock() {
+      #ifdef ARDUINO_ARCH_ESP32
+        _handle = xSemaphoreCreateMutexStatic(&_buffer);
+      #endif
+    };
+    Lock(const Lock &) = delete;
+    Lock &operator=(const Lock &) = delete;
+    ~Lock() {
+      #ifdef ARDUINO_ARCH_ESP32
+        vSemaphoreDelete(_handle);
+      #endif
+    }
+
+    void lock() {
+      #ifdef ARDUINO_ARCH_ESP32
+        xSemaphoreTake(_handle, portMAX_DELAY);
+      #endif
+    }
+
+    // @returns false if lock is held by another task
+    bool tryLock() {
+      #ifdef ARDUINO_ARCH_ESP32
+        return xSemaphoreTake(_handle, 0) == pdTRUE;
+      #else
+        return true;
+      #endif
+    }
+
+    void unlock() {
+      #ifdef ARDUINO_ARCH_ESP32
+        xSemaphoreGive(_handle);
+      #endif
+    }
+
+  private:
+    #ifdef ARDUINO_ARCH_ESP32
+      StaticSemaphore_t _buffer;
+      SemaphoreHandle_t _handle;
+    #endif
+};
+
+// Holds lock until end of the scope
+class LockGuard {
+  public:
+    LockGuard(Lock &lock): _lock(lock) {
+      _lock.lock();
+    };
+    ~LockGuard() {
+      _lock.unlock();
+    }
+  private:
+    Lock &_lock;
+};
+
+#endif
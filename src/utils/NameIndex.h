@@ -0,0 +1,145 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <Arduino.h>
+
+#define NAME_INDEX_INITIAL_CAPACITY 8
+
+// FNV-1a hash of zero terminated string
+inline uint32_t hashName(const char * name) {
+  uint32_t hash = 2166136261u;
+  if (name == nullptr) {
+    return hash;
+  }
+  for (; *name != 0; name++) {
+    hash ^= (uint8_t) *name;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+  Open addressing (linear probing) index of objects by their name.
+  T must provide const char * name() const.
+  Index doesn't own stored objects.
+*/
+template <typename T>
+class NameIndex {
+  public:
+    NameIndex(): _entries(nullptr), _capacity(0), _size(0) {};
+    ~NameIndex() {
+      free(_entries);
+    }
+
+    T * find(const char * name) const {
+      if (name == nullptr || _size == 0) {
+        return nullptr;
+      }
+      uint32_t hash = hashName(name);
+      for (size_t i = hash & (_capacity - 1);; i = (i + 1) & (_capacity - 1)) {
+        Entry &entry = _entries[i];
+        if (entry.value == nullptr) {
+          return nullptr;
+        }
+        if (entry.hash == hash && strcmp(entry.value->name(), name) == 0) {
+          return entry.value;
+        }
+      }
+    }
+
+    bool contains(const char * name) const {
+      return find(name) != nullptr;
+    }
+
+    // Value's name must be unique and stay the same while value is in index
+    bool put(T * value) {
+      if (value == nullptr) {
+        return false;
+      }
+      if ((_size + 1) * 4 > _capacity * 3 && !grow()) {
+        return false;
+      }
+      insert(hashName(value->name()), value);
+      _size++;
+      return true;
+    }
+
+    bool remove(const char * name) {
+      if (name == nullptr || _size == 0) {
+        return false;
+      }
+      uint32_t hash = hashName(name);
+      size_t mask = _capacity - 1;
+      size_t i = hash & mask;
+      for (;; i = (i + 1) & mask) {
+        if (_entries[i].value == nullptr) {
+          return false;
+        }
+        if (_entries[i].hash == hash && strcmp(_entries[i].value->name(), name) == 0) {
+          break;
+        }
+      }
+
+      // backward shift deletion, keeps probe chains without tombstones
+      size_t j = i;
+      while (true) {
+        _entries[i].value = nullptr;
+        size_t home;
+        do {
+          j = (j + 1) & mask;
+          if (_entries[j].value == nullptr) {
+            _size--;
+            return true;
+          }
+          home = _entries[j].hash & mask;
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        _entries[i] = _entries[j];
+        i = j;
+      }
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+  private:
+    struct Entry {
+      uint32_t hash;
+      T * value;
+    };
+
+    Entry * _entries;
+    size_t _capacity;
+    size_t _size;
+
+    void insert(uint32_t hash, T * value) {
+      size_t i = hash & (_capacity - 1);
+      while (_entries[i].value != nullptr) {
+        i = (i + 1) & (_capacity - 1);
+      }
+      _entries[i].hash = hash;
+      _entries[i].value = value;
+    }
+
+    bool grow() {
+      size_t capacity = _capacity == 0 ? NAME_INDEX_INITIAL_CAPACITY : _capacity * 2;
+      Entry * entries = (Entry *) calloc(capacity, sizeof(Entry));
+      if (entries == nullptr) {
+        return false;
+      }
+
+      Entry * old = _entries;
+      size_t oldCapacity = _capacity;
+      _entries = entries;
+      _capacity = capacity;
+      for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].value != nullptr) {
+          insert(old[i].hash, old[i].value);
+        }
+      }
+      free(old);
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <Arduino.h>
+#include <vector>
+
+#ifdef ARDUINO_ARCH_ESP32
+  #include <atomic>
+  typedef std::atomic<uint32_t> RcuCounter;
+#else
+  // esp8266 runs everything in one context
+  typedef volatile uint32_t RcuCounter;
+#endif
+
+/*
+  Pointer to data which is read by one task and replaced by another.
+  Readers get either old or new object, never a half built one.
+*/
+template <typename T>
+class RcuPointer {
+  public:
+    RcuPointer(T * value = nullptr): _value(value) {};
+
+    T * load() const {
+      return _value;
+    }
+
+    void publish(T * value) {
+      _value = value;
+    }
+
+  private:
+    #ifdef ARDUINO_ARCH_ESP32
+      std::atomic<T*> _value;
+    #else
+      T * _value;
+    #endif
+};
+
+/*
+  Read-copy-update domain.
+  Readers wrap access to published data into read section (RcuReadGuard),
+  it costs two counter updates and never waits.
+  Writers (serialized by caller) publish new version of data and retire the old one.
+  Retired objects are deleted by reclaim() once no read section can see them.
+
+  Grace periods are tracked by epoch and two counters of active readers (one per epoch parity).
+  Epoch advances only when readers which entered in the previous epoch are gone,
+  so object retired in epoch E is unreachable when epoch reaches E + 2.
+*/
+class RcuDomain {
+  public:
+    RcuDomain(): _epoch(0), _retiredCount(0) {
+      _readers[0] = 0;
+      _readers[1] = 0;
+    };
+
+    // @returns reader phase to pass to readUnlock
+    uint8_t readLock() {
+      uint8_t phase = _epoch & 1;
+      _readers[phase]++;
+      return phase;
+    }
+
+    void readUnlock(uint8_t phase) {
+      _readers[phase]--;
+    }
+
+    // Delete object after grace period, writer only
+    template <typename T>
+    void retire(T * object) {
+      retire(object, &destroy<T>);
+    }
+
+    // Pass object to destroy after grace period, writer only
+    void retire(void * object, void (*destroy)(void * object)) {
+      if (object == nullptr) {
+        return;
+      }
+      _retired.push_back({object, destroy, _epoch});
+      _retiredCount = _retired.size();
+    }
+
+    // Try to advance epoch and delete retired objects nobody can see, writer only
+    void reclaim() {
+      if (_retired.empty()) {
+        return;
+      }
+      for (uint8_t i = 0; i < 2; i++) {
+        uint32_t epoch = _epoch;
+        // (epoch + 1) & 1 is parity of the previous epoch
+        if (_readers[(epoch + 1) & 1] != 0) {
+          break;
+        }
+        _epoch = epoch + 1;
+      }
+
+      uint32_t epoch = _epoch;
+      size_t kept = 0;
+      for (size_t i = 0; i < _retired.size(); i++) {
+        if (epoch - _retired[i].epoch >= 2) {
+          _retired[i].destroy(_retired[i].object);
+        } else {
+          _retired[kept++] = _retired[i];
+        }
+      }
+      _retired.resize(kept);
+      _retiredCount = kept;
+    }
+
+    // Can be checked by readers to decide if reclaim is worth taking writer lock
+    bool hasRetired() const {
+      return _retiredCount != 0;
+    }
+
+  private:
+    struct Retired {
+      void * object;
+      void (*destroy)(void * object);
+      uint32_t epoch;
+    };
+
+    RcuCounter _epoch;
+    RcuCounter _readers[2];
+    RcuCounter _retiredCount;
+    std::vector<Retired> _retired;
+
+    template <typename T>
+    static void destroy(void * object) {
+      delete (T *) object;
+    }
+};
+
+class RcuReadGuard {
+  public:
+    RcuReadGuard(RcuDomain &domain): _domain(domain), _phase(domain.readLock()) {};
+    ~RcuReadGuard() {
+      _domain.readUnlock(_phase);
+    }
+
+  private:
+    RcuDomain &_domain;
+    uint8_t _phase;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "Features.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utils/NameIndex.h"
+
+/*
+  Name for registered object: a heap copy, or the literal itself
+  in static registry mode. Release it with freeRegistryName.
+*/
+inline const char * registryName(const char * name) {
+  #if ENABLE_STATIC_REGISTRY
+    return name;
+  #else
+    char * copy = (char *) malloc(strlen(name) + 1);
+    strcpy(copy, name);
+    return copy;
+  #endif
+}
+
+inline void freeRegistryName(const char * name) {
+  #if !ENABLE_STATIC_REGISTRY
+    free((void *) name);
+  #endif
+}
+
+#if ENABLE_STATIC_REGISTRY
+
+/*
+  Registry of named objects (sensors, actions, config entries) in fixed arrays.
+  Objects are constructed in place, so registry takes no heap.
+  Objects keep insertion order, lookup returns array index.
+  T must provide const char * name() const.
+*/
+template <typename T, size_t Capacity>
+class Registry {
+  public:
+    typedef T * const * iterator;
+
+    Registry(): _size(0) {
+      memset(_busy, 0, sizeof(_busy));
+    };
+    ~Registry() {
+      for (size_t i = 0; i < _size; i++) {
+        _items[i]->~T();
+      }
+    }
+
+    /*
+      Construct new object in free slot
+      @returns new object or nullptr if registry is full
+    */
+    template <typename... Args>
+    T * add(Args&&... args) {
+      if (_size >= Capacity) {
+        return nullptr;
+      }
+      size_t slot = 0;
+      while (_busy[slot]) {
+        slot++;
+      }
+      T * item = new (_slots[slot]) T(std::forward<Args>(args)...);
+      _busy[slot] = true;
+      _items[_size] = item;
+      _hashes[_size] = hashName(item->name());
+      _size++;
+      return item;
+    }
+
+    // @returns index of object in registry or -1
+    int indexOf(const char * name) const {
+      if (name == nullptr) {
+        return -1;
+      }
+      // names are literals, so callers using the same literal pass the same pointer
+      for (size_t i = 0; i < _size; i++) {
+        if (_items[i]->name() == name) {
+          return i;
+        }
+      }
+      uint32_t hash = hashName(name);
+      for (size_t i = 0; i < _size; i++) {
+        if (_hashes[i] == hash && strcmp(_items[i]->name(), name) == 0) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    T * at(size_t index) const {
+      return index < _size ? _items[index] : nullptr;
+    }
+
+    T * find(const char * name) const {
+      int index = indexOf(name);
+      return index < 0 ? nullptr : _items[index];
+    }
+
+    bool contains(const char * name) const {
+      return indexOf(name) >= 0;
+    }
+
+    bool remove(const char * name) {
+      int index = indexOf(name);
+      if (index < 0) {
+        return false;
+      }
+      T * item = _items[index];
+      _busy[((unsigned char *) item - _slots[0]) / sizeof(T)] = false;
+      item->~T();
+      for (size_t i = index + 1; i < _size; i++) {
+        _items[i - 1] = _items[i];
+        _hashes[i - 1] = _hashes[i];
+      }
+      _size--;
+      return true;
+    }
+
+    size_t size() const { return _size; }
+    iterator begin() const { return _items; }
+    iterator end() const { return _items + _size; }
+
+  private:
+    alignas(T) unsigned char _slots[Capacity][sizeof(T)];
+    bool _busy[Capacity];
+    // objects in insertion order and hashes of their names
+    T * _items[Capacity];
+    uint32_t _hashes[Capacity];
+    size_t _size;
+};
+
+#else
+
+/*
+  Registry of named objects (sensors, actions, config entries).
+  Objects are allocated on add, kept in insertion order and indexed by name.
+  T must provide const char * name() const.
+*/
+template <typename T, size_t Capacity>
+class Registry {
+  public:
+    typedef T * const * iterator;
+
+    ~Registry() {
+      for (T * item : _items) {
+        delete item;
+      }
+    }
+
+    /*
+      Create new object
+      @returns new object or nullptr if it can't be indexed
+    */
+    template <typename... Args>
+    T * add(Args&&... args) {
+      T * item = new T(std::forward<Args>(args)...);
+      if (!_index.put(item)) {
+        delete item;
+        return nullptr;
+      }
+      _items.push_back(item);
+      return item;
+    }
+
+    T * find(const char * name) const {
+      return _index.find(name);
+    }
+
+    bool contains(const char * name) const {
+      return _index.contains(name);
+    }
+
+    bool remove(const char * name) {
+      T * item = _index.find(name);
+      if (item == nullptr) {
+        return false;
+      }
+      _index.remove(name);
+      _items.erase(std::find(_items.begin(), _items.end(), item));
+      delete item;
+      return true;
+    }
+
+    size_t size() const { return _items.size(); }
+    iterator begin() const { return _items.data(); }
+    iterator end() const { return _items.data() + _items.size(); }
+
+  private:
+    std::vector<T*> _items;
+    NameIndex<T> _index;
+};
+
+#endif
+
+#endif
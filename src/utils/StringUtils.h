@@ -23,43 +23,5 @@ inline bool trimUrl(String &url) {
   }
   return false;
 }
-// replaces keys in string with config values
-// not optimal impl, but it ok for now
-inline String replaceValues(const char * input, String &value) {
-  String result = "";
-  String key = "";
-  bool opened = false;
-
-  for (int i = 0; i < (int) strlen(input); i++) {
-    if (input[i] == '{') {
-      if (opened) {
-        result += "{" + key;
-        key.clear();
-      }
-      opened = true;
-    } else if (opened) {
-      if (input[i] == '}') {
-        if (key.equals(VALUE_DYNAMIC_PARAM)) {
-          result += value;
-        } 
-        #if ENABLE_CONFIG
-          else {
-            result += ConfigManager.get(key.c_str());
-          }
-        #endif
-        opened = false;
-        key.clear();
-      } else {
-        key += input[i];
-      }
-    } else {
-      result += input[i];
-    }
-  }
-  if (opened && key.length() > 0) {
-    result += "{" + key;
-  }
-  return result;
-}
 
 #endif
\ No newline at end of file
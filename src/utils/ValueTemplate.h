@@ -0,0 +1,215 @@
+#ifndef VALUE_TEMPLATE_H
+#define VALUE_TEMPLATE_H
+
+#include <Arduino.h>
+#include <vector>
+
+#include "Features.h"
+#include "config/ConfigManager.h"
+#include "logs/BetterLogger.h"
+#include "utils/Lock.h"
+#include "utils/StringUtils.h"
+
+const char * const _VALUE_TEMPLATE_TAG = "value_template";
+
+/*
+  String with {v} (sensor value) and {config_key} placeholders,
+  compiled once into segments: literal spans, value slots and config entries.
+  Rendering is a single pass into a pre-sized string.
+  Config values are copied when config changes, so rendering doesn't touch entries
+  which can be changed by another task. Template can be rendered from several tasks.
+*/
+class ValueTemplate {
+  public:
+    ValueTemplate() {};
+    ValueTemplate(const char * input) {
+      compile(input);
+    };
+
+    void compile(const char * input) {
+      _source = input == nullptr ? "" : input;
+      _segments.clear();
+      #if ENABLE_CONFIG
+        _entries.clear();
+        _configValues.clear();
+      #endif
+      _literalLength = 0;
+      _valueSlots = 0;
+      _configSlots = 0;
+      _resolved = false;
+
+      const char * source = _source.c_str();
+      size_t length = _source.length();
+      size_t literalStart = 0, braceAt = 0;
+      bool opened = false;
+      for (size_t i = 0; i < length; i++) {
+        if (source[i] == '{') {
+          // unclosed "{key" before this brace stays in literal span
+          opened = true;
+          braceAt = i;
+        } else if (opened && source[i] == '}') {
+          addLiteral(literalStart, braceAt);
+          addPlaceholder(braceAt + 1, i);
+          opened = false;
+          literalStart = i + 1;
+        }
+      }
+      // lonely '{' at the end is dropped
+      addLiteral(literalStart, opened && braceAt == length - 1 ? braceAt : length);
+      _segments.shrink_to_fit();
+    }
+
+    void compile(const String &input) {
+      compile(input.c_str());
+    }
+
+    const String &source() const {
+      return _source;
+    }
+
+    String render(const String &value) const {
+      #if ENABLE_CONFIG
+        if (_configSlots > 0) {
+          // copied config values are shared by all renders
+          LockGuard guard(resolveLock());
+          if (!_resolved || _configVersion != ConfigManager.version()) {
+            resolve();
+          }
+          return build(value);
+        }
+      #endif
+      return build(value);
+    }
+
+  private:
+    enum SegmentType : uint8_t {
+      SEGMENT_LITERAL,
+      SEGMENT_VALUE,
+      SEGMENT_CONFIG
+    };
+
+    struct Segment {
+      SegmentType type;
+      uint16_t offset;
+      uint16_t length;
+    };
+
+    String _source;
+    std::vector<Segment> _segments;
+    size_t _literalLength = 0;
+    uint8_t _valueSlots = 0;
+    uint8_t _configSlots = 0;
+    #if ENABLE_CONFIG
+      // config entries and copies of their values in config segments order, guarded by resolveLock
+      mutable std::vector<ConfigEntry *> _entries;
+      mutable std::vector<String> _configValues;
+      mutable size_t _configLength = 0;
+      mutable bool _resolved = false;
+      mutable uint32_t _configVersion = 0;
+    #endif
+
+    String build(const String &value) const {
+      String result;
+      size_t length = _literalLength + _valueSlots * value.length();
+      #if ENABLE_CONFIG
+        length += _configLength;
+      #endif
+      result.reserve(length);
+      const char * source = _source.c_str();
+      size_t slot = 0;
+      for (const Segment &segment : _segments) {
+        switch (segment.type) {
+          case SEGMENT_LITERAL:
+            result.concat(source + segment.offset, segment.length);
+            break;
+          case SEGMENT_VALUE:
+            result.concat(value);
+            break;
+          case SEGMENT_CONFIG:
+            #if ENABLE_CONFIG
+              result.concat(_configValues[slot++]);
+            #endif
+            break;
+        }
+      }
+      return result;
+    }
+
+    void addLiteral(size_t from, size_t to) {
+      if (to <= from) {
+        return;
+      }
+      Segment segment = {};
+      segment.type = SEGMENT_LITERAL;
+      segment.offset = from;
+      segment.length = to - from;
+      _segments.push_back(segment);
+      _literalLength += segment.length;
+    }
+
+    void addPlaceholder(size_t from, size_t to) {
+      Segment segment = {};
+      segment.offset = from;
+      segment.length = to - from;
+      if (segment.length == strlen(VALUE_DYNAMIC_PARAM) &&
+          strncmp(_source.c_str() + from, VALUE_DYNAMIC_PARAM, segment.length) == 0) {
+        segment.type = SEGMENT_VALUE;
+        _valueSlots++;
+      } else {
+        #if ENABLE_CONFIG
+          segment.type = SEGMENT_CONFIG;
+          _configSlots++;
+          _entries.push_back(nullptr);
+          _configValues.push_back(String());
+        #else
+          return;
+        #endif
+      }
+      _segments.push_back(segment);
+    }
+
+    #if ENABLE_CONFIG
+    static Lock &resolveLock() {
+      static Lock lock;
+      return lock;
+    }
+
+    /*
+      Looks up config entries and copies their values, called only when config
+      was changed since last render. resolveLock must be held.
+    */
+    void resolve() const {
+      // taken before copying, so change made meanwhile is picked up by next render
+      _configVersion = ConfigManager.version();
+      _configLength = 0;
+      char key[MAX_CONFIG_ENTRY_NAME_LENGTH + 1];
+      size_t slot = 0;
+      for (const Segment &segment : _segments) {
+        if (segment.type != SEGMENT_CONFIG) {
+          continue;
+        }
+        ConfigEntry * &entry = _entries[slot];
+        String &value = _configValues[slot];
+        slot++;
+        // entries live until reboot, only missing ones are looked up again
+        if (entry == nullptr && segment.length > 0 && segment.length <= MAX_CONFIG_ENTRY_NAME_LENGTH) {
+          memcpy(key, _source.c_str() + segment.offset, segment.length);
+          key[segment.length] = 0;
+          entry = ConfigManager.getEntry(key);
+          if (entry == nullptr) {
+            st_log_warning(_VALUE_TEMPLATE_TAG, "Config entry with name %s not found", key);
+          }
+        }
+        if (entry != nullptr) {
+          ConfigManager.copyValue(entry, value);
+        } else {
+          value.clear();
+        }
+        _configLength += value.length();
+      }
+      _resolved = true;
+    }
+    #endif
+};
+
+#endif
@@ -0,0 +1,192 @@
+#!/bin/python3
+
+# Compares gateway -> device round trip over http requests and over websocket connection
+# (device must be built with ENABLE_GATEWAY_WS=1).
+# Script runs minimal websocket gateway, points device gateway config (gtw) to it,
+# waits until device connects and calls ACTION and reads sensors both ways.
+# Previous config is restored at the end.
+
+import base64
+import hashlib
+import json
+import socket
+import struct
+import threading
+import time
+import urllib.request
+
+DEVICE = "192.168.1.12"
+ACTION = "led_on"
+PORT = 8090
+ITERATIONS = 50
+CONNECT_TIMEOUT = 60
+REPLY_TIMEOUT = 5
+
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+def request(method, path, body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    rq = urllib.request.Request(f"http://{DEVICE}{path}", data=data, method=method)
+    if data is not None:
+        rq.add_header("Content-Type", "application/json")
+    with urllib.request.urlopen(rq, timeout=10) as response:
+        content = response.read()
+        return json.loads(content) if content else None
+
+def localIp():
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.connect((DEVICE, 80))
+        return s.getsockname()[0]
+
+class Gateway(threading.Thread):
+    def __init__(self, port):
+        super().__init__(daemon=True)
+        self.server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.server.bind(("0.0.0.0", port))
+        self.server.listen(1)
+        self.connection = None
+        self.device = None
+        self.connected = threading.Event()
+        self.replies = {}
+        self.repliesCondition = threading.Condition()
+        self.events = {}
+        self.lastId = 0
+        self.sendLock = threading.Lock()
+
+    def run(self):
+        while True:
+            connection, address = self.server.accept()
+            connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            try:
+                self.serve(connection)
+            except (ConnectionError, OSError) as e:
+                print(f"Device {address[0]} disconnected: {e}")
+            finally:
+                self.connection = None
+                self.connected.clear()
+                connection.close()
+
+    def serve(self, connection):
+        reader = connection.makefile("rb")
+        key = None
+        while True:
+            line = reader.readline().decode().strip()
+            if not line:
+                break
+            name, _, value = line.partition(":")
+            if name.lower() == "sec-websocket-key":
+                key = value.strip()
+        accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        connection.sendall((
+            "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Accept: {accept}\r\n\r\n"
+        ).encode())
+        self.connection = connection
+
+        while True:
+            opcode, payload = self.readFrame(reader)
+            if opcode == 0x1:
+                for line in payload.decode().splitlines():
+                    if line:
+                        self.handleMessage(json.loads(line))
+            elif opcode == 0x9:
+                self.sendFrame(0xA, payload)
+            elif opcode == 0x8:
+                self.sendFrame(0x8, payload[:2])
+                raise ConnectionError("closed by device")
+
+    def readFrame(self, reader):
+        header = reader.read(2)
+        if len(header) < 2:
+            raise ConnectionError("connection closed")
+        opcode = header[0] & 0x0F
+        length = header[1] & 0x7F
+        if length == 126:
+            length = struct.unpack(">H", reader.read(2))[0]
+        elif length == 127:
+            length = struct.unpack(">Q", reader.read(8))[0]
+        mask = reader.read(4) if header[1] & 0x80 else None
+        payload = reader.read(length)
+        if mask:
+            payload = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        return opcode, payload
+
+    def sendFrame(self, opcode, payload):
+        if len(payload) < 126:
+            header = struct.pack(">BB", 0x80 | opcode, len(payload))
+        elif len(payload) <= 0xFFFF:
+            header = struct.pack(">BBH", 0x80 | opcode, 126, len(payload))
+        else:
+            header = struct.pack(">BBQ", 0x80 | opcode, 127, len(payload))
+        with self.sendLock:
+            self.connection.sendall(header + payload)
+
+    def handleMessage(self, message):
+        if "id" in message:
+            with self.repliesCondition:
+                self.replies[message["id"]] = message
+                self.repliesCondition.notify_all()
+            return
+        event = message.get("ev")
+        self.events[event] = self.events.get(event, 0) + 1
+        if event == "hello":
+            self.device = message["data"]
+            self.connected.set()
+
+    def call(self, op, **args):
+        self.lastId += 1
+        id = self.lastId
+        self.sendFrame(0x1, json.dumps({"id": id, "op": op, **args}).encode())
+        with self.repliesCondition:
+            if not self.repliesCondition.wait_for(lambda: id in self.replies, REPLY_TIMEOUT):
+                raise TimeoutError(f"No reply for {op}")
+            return self.replies.pop(id)
+
+def measure(name, call):
+    times = []
+    for i in range(ITERATIONS):
+        started = time.perf_counter()
+        call()
+        times.append((time.perf_counter() - started) * 1000)
+    times.sort()
+    avg = sum(times) / len(times)
+    p95 = times[min(len(times) - 1, int(len(times) * 0.95))]
+    print(f"{name: <22} {avg: >8.1f} {times[len(times) // 2]: >8.1f} {p95: >8.1f} {times[-1]: >8.1f}")
+
+def callOverWs(gateway, op, **args):
+    reply = gateway.call(op, **args)
+    if reply["code"] >= 300:
+        raise RuntimeError(f"{op} failed: {reply}")
+
+if __name__ == "__main__":
+    gateway = Gateway(PORT)
+    gateway.start()
+
+    config = request("GET", "/config") or {}
+    previous = config.get("gtw")
+    config["gtw"] = f"{localIp()}:{PORT}"
+    print(f"Setting device gateway to {config['gtw']}")
+    request("POST", "/config", config)
+    try:
+        print("Waiting for device connection...")
+        if not gateway.connected.wait(CONNECT_TIMEOUT):
+            raise TimeoutError("Device didn't connect, is it built with ENABLE_GATEWAY_WS=1?")
+        print(f"Device {gateway.device['name']} connected")
+
+        print(f"{'CALL': <22} {'AVG MS': >8} {'P50 MS': >8} {'P95 MS': >8} {'MAX MS': >8}")
+        measure("http /actions/call", lambda: request("GET", f"/actions/call?name={ACTION}"))
+        measure("ws action", lambda: callOverWs(gateway, "action", name=ACTION))
+        measure("http /sensors", lambda: request("GET", "/sensors"))
+        measure("ws sensors", lambda: callOverWs(gateway, "sensors"))
+
+        print(f"Events received: {gateway.events}")
+    except KeyboardInterrupt:
+        print("leaving...")
+    finally:
+        if previous is None:
+            config.pop("gtw", None)
+        else:
+            config["gtw"] = previous
+        print("Restoring device config")
+        request("POST", "/config", config)
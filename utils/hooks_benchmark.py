@@ -0,0 +1,91 @@
+#!/bin/python3
+
+# Measures hooks check time on device against total hooks count.
+# For every step it adds hooks which never fire (trigger on unreachable value)
+# to SENSOR, keeping FIRING_HOOKS hooks which fire on every value change,
+# and reads timings.hooksCheck from /metrics.
+# SENSOR must be a number sensor which value changes often (counter, analog pin).
+# Created hooks are removed at the end.
+# Hooks are saved in settings, so steps above ~100 hooks need bigger SETTINGS_STORAGE_SIZE
+# in firmware (see FEATURE_FLAGS.md), adding hooks stops on the first rejected one.
+
+import json
+import time
+import urllib.error
+import urllib.request
+
+DEVICE = "192.168.1.12"
+SENSOR = "counter"
+FIRING_HOOKS = 5
+# compare type of hooks which never fire: eq, gte or lte
+IDLE_COMPARE = "eq"
+STEPS = [0, 100, 250, 500, 1000, 2000]
+# distinct fired checks to collect on each step
+SAMPLES = 20
+SAMPLE_TIMEOUT = 30
+
+HOOK_URL = "127.0.0.1:1/{v}"
+
+def request(method, path, body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    rq = urllib.request.Request(f"http://{DEVICE}{path}", data=data, method=method)
+    if data is not None:
+        rq.add_header("Content-Type", "application/json")
+    with urllib.request.urlopen(rq, timeout=10) as response:
+        content = response.read()
+        return json.loads(content) if content else None
+
+def addHook(index=None):
+    hook = {"type": "http", "url": HOOK_URL, "method": 1, "compareType": IDLE_COMPARE}
+    if index is not None:
+        hook["triggerEnabled"] = True
+        # out of sensor values range
+        hook["trigger"] = 1000000 + index if IDLE_COMPARE == "gte" else -1000000 - index
+    return request("POST", "/hooks", {"sensor": SENSOR, "hook": hook})["id"]
+
+def sample():
+    seen = set()
+    times = []
+    calls = 0
+    started = time.time()
+    while len(times) < SAMPLES and time.time() - started < SAMPLE_TIMEOUT:
+        check = request("GET", "/metrics")["timings"]["hooksCheck"]
+        key = (check["lastFired"], check["lastFiredCalls"], check["last"])
+        if check["lastFiredCalls"] > 0 and key not in seen:
+            seen.add(key)
+            times.append(check["lastFired"])
+            calls = check["lastFiredCalls"]
+        time.sleep(0.05)
+    return times, calls
+
+if __name__ == "__main__":
+    created = []
+    try:
+        for i in range(FIRING_HOOKS):
+            created.append(addHook())
+
+        print(f"{'HOOKS': >7} {'CALLED': >7} {'AVG US': >8} {'MAX US': >8} {'US/CALL': >8}")
+        idle = 0
+        for step in STEPS:
+            try:
+                while idle < step:
+                    created.append(addHook(idle))
+                    idle += 1
+            except urllib.error.HTTPError as e:
+                print(f"{FIRING_HOOKS + idle: >7} hook rejected ({e.code}), settings storage is full?")
+                break
+            times, calls = sample()
+            if not times:
+                print(f"{FIRING_HOOKS + idle: >7} no fired checks, is {SENSOR} changing?")
+                continue
+            avg = sum(times) / len(times)
+            print(f"{FIRING_HOOKS + idle: >7} {calls: >7} {avg: >8.0f} {max(times): >8} {avg / max(calls, 1): >8.1f}")
+    except KeyboardInterrupt:
+        print("leaving...")
+    finally:
+        print(f"Removing {len(created)} hooks...")
+        for id in created:
+            try:
+                request("DELETE", f"/hooks?sensor={SENSOR}&id={id}")
+            except Exception as e:
+                print(f"Failed to remove hook {id}: {e}")